@@ -0,0 +1,70 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "readback.h"
+
+typedef enum CaptureFormat {
+  // Back-to-back R8G8B8A8 frames, no header.
+  CAPTURE_FORMAT_RAW,
+  // YUV4MPEG2 with 4:4:4 chroma, readable by ffmpeg and most encoders.
+  CAPTURE_FORMAT_Y4M,
+} CaptureFormat;
+
+typedef struct CaptureSettings {
+  // File path, "-" for stdout, or "|command" to pipe into a process.
+  const char *path;
+  CaptureFormat format;
+  Uint32 width;
+  Uint32 height;
+  Uint32 fps;
+  // Stop after this many frames; 0 records until the app quits.
+  Uint64 maxFrames;
+} CaptureSettings;
+
+// Offline frame capture. Frames are rendered into an offscreen texture,
+// downloaded through a ring of transfer buffers and written out by a worker
+// thread, so the frame loop never waits on the GPU or on I/O.
+typedef struct Capture {
+  SDL_GPUTexture *texture;
+  Uint32 width;
+  Uint32 height;
+  Uint32 fps;
+  CaptureFormat format;
+  Uint64 maxFrames;
+  Uint64 framesSubmitted;
+
+  ReadbackRing ring;
+  FILE *out;
+  bool isPipe;
+  // Worker-thread scratch for the planar Y4M conversion.
+  Uint8 *planes;
+  bool writeFailed;
+} Capture;
+
+// Parses "raw" / "y4m". Returns false for anything else.
+bool Capture_ParseFormat(const char *name, CaptureFormat *outFormat);
+
+bool Capture_Init(Capture *capture,
+                  SDL_GPUDevice *device,
+                  const CaptureSettings *settings);
+
+// Flushes every pending frame to the output before closing it.
+void Capture_Destroy(Capture *capture, SDL_GPUDevice *device);
+
+// True when a download slot is free for the next frame. Capture mode paces
+// the simulation on this instead of dropping frames or blocking the submit.
+bool Capture_Ready(Capture *capture);
+
+// True once maxFrames have been submitted.
+bool Capture_Finished(const Capture *capture);
+
+// Records the download of the capture texture, submits the command buffer and
+// hands the frame to the writer. Consumes cmdBuf in every case.
+bool Capture_SubmitFrame(Capture *capture, SDL_GPUCommandBuffer *cmdBuf);
+
+#endif // CAPTURE_H
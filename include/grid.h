@@ -0,0 +1,172 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+
+#include "kernel_variants.h"
+
+// Uint planes of SIM_BINDING_GRID after the per-cell counts, starts and, in
+// the sparse layout, hash table keys (numCells entries each), each one uint
+// per particle slot. With neighbour lists, GridUniforms.maxNeighbors entries
+// per slot follow the planes, then the scan's per-block sums (two uints per
+// GRID_SCAN_BLOCK cells, plus the totals).
+typedef enum GridPlane {
+  // Cell index of each slot.
+  GRID_PLANE_CELL = 0,
+  // Order of each slot within its cell.
+  GRID_PLANE_RANK,
+  // By sorted index: the slot the entry was copied from.
+  GRID_PLANE_SORTED_SLOT,
+  // Merge partner each slot proposed this step (see refine.h).
+  GRID_PLANE_PARTNER,
+  // Neighbour lists: position (float bits) each slot had when its list was
+  // built, and the list's length.
+  GRID_PLANE_LIST_X,
+  GRID_PLANE_LIST_Y,
+  GRID_PLANE_LIST_COUNT,
+  // By compacted index: the occupied cells in cell order, for the tiled
+  // passes.
+  GRID_PLANE_OCCUPIED,
+  GRID_PLANE_COUNT,
+} GridPlane;
+
+// Float planes of SIM_BINDING_GRID_SORTED, indexed by sorted position so each
+// cell's particles are contiguous.
+typedef enum SortedPlane {
+  SORTED_PLANE_X = 0,
+  SORTED_PLANE_Y,
+  SORTED_PLANE_MASS,
+  SORTED_PLANE_DENSITY,
+  SORTED_PLANE_COUNT,
+} SortedPlane;
+
+// Widest dense grid along an axis. Finer dense grids mostly add empty cells
+// to clear and scan every step.
+#define GRID_MAX_CELLS_PER_AXIS 255
+// Cells per scan block; mirrors SCAN_BLOCK in particles.slang.
+#define GRID_SCAN_BLOCK 1024
+// Largest dense grid, counting every scene's cells. The dense layout clears
+// and scans every cell each step, so bigger batches fall back to the sparse
+// layout.
+#define GRID_MAX_DENSE_CELLS (1u << 22)
+// Sparse table keys pack the scene above two 10-bit cell coordinates. Cell
+// coordinates are hashed unclamped, modulo 1024, so sparse cells need not
+// lie in the grid's bounds; only the scene index is a hard limit. Scene 4095 is
+// left out: its cell (1023, 1023) would pack to EMPTY_CELL.
+#define GRID_MAX_SPARSE_CELLS_PER_AXIS 1023
+#define GRID_MAX_SPARSE_SCENES 4095
+// Neighbour list length. Lists hold GRID_NEIGHBOR_SLACK times the particles
+// expected within reach at rest density, and at least GRID_MIN_NEIGHBORS;
+// list mode is refused when that is over GRID_MAX_NEIGHBORS. Neighbours past
+// the end are dropped and counted in POOL_COUNTER_LIST_OVERFLOW.
+#define GRID_NEIGHBOR_SLACK 1.5f
+#define GRID_MIN_NEIGHBORS 64
+#define GRID_MAX_NEIGHBORS 1024
+
+// World-space box the grid spans: the union of the scenes' domains.
+typedef struct GridBounds {
+  float minX;
+  float minY;
+  float maxX;
+  float maxY;
+} GridBounds;
+
+// Mirrors GridParams in particles.slang, pushed at compute uniform slot 1.
+typedef struct GridUniforms {
+  // GridBounds' low corner.
+  float originX;
+  float originY;
+  // Each axis of the bounds is cut into gridX or gridY whole cells.
+  float invCellSizeX;
+  float invCellSizeY;
+  Uint32 gridX;
+  Uint32 gridY;
+  // Dense: gridX * gridY * numScenes, every scene gets its own block of
+  // cells. Sparse: the hash table size.
+  Uint32 numCells;
+  Uint32 numScenes;
+  // BoundaryMode of the domain, for passes not specialized on it.
+  Uint32 boundary;
+  // numCells - 1 for the sparse layout (a power of two), 0 for the dense.
+  Uint32 tableMask;
+  // Verlet skin; 0 when there are no neighbour lists.
+  float skin;
+  // Entries per neighbour list; 0 when there are none.
+  Uint32 maxNeighbors;
+  // GRID_SCAN_BLOCK-cell blocks covering numCells.
+  Uint32 numScanBlocks;
+  // GridBounds' size, which periodic domains wrap by.
+  float periodX;
+  float periodY;
+  Uint32 pad;
+} GridUniforms;
+
+// Uniform grid over GridBounds, rebuilt from the live particles every step
+// by a counting sort. Cells are at least as wide as the largest smoothing
+// radius, so neighbour searches only look at the surrounding 3x3 cells.
+// The sparse layout hashes occupied cells into a table of at least twice
+// the capacity, so memory and clear time follow the particle count rather
+// than the number of cells.
+//
+// In NEIGHBOR_MODE_LIST the build also gathers each particle's neighbours
+// within its support radius plus a skin into a list. integrate records how
+// far particles have moved from where their lists were built and finalize
+// whether the live set changed; gridGateCS turns that into the build's
+// indirect arguments, so the sort and lists are only redone once a particle
+// may have moved half the skin, without any CPU readback.
+typedef struct NeighborGrid {
+  SDL_GPUComputePipeline *gatePipeline;
+  SDL_GPUComputePipeline *clearPipeline;
+  SDL_GPUComputePipeline *countPipeline;
+  SDL_GPUComputePipeline *scanReducePipeline;
+  SDL_GPUComputePipeline *scanBlocksPipeline;
+  SDL_GPUComputePipeline *scanDownPipeline;
+  SDL_GPUComputePipeline *scatterPipeline;
+  // NULL without neighbour lists.
+  SDL_GPUComputePipeline *listPipeline;
+  // SIM_BINDING_GRID and SIM_BINDING_GRID_SORTED.
+  SDL_GPUBuffer *gridBuffer;
+  SDL_GPUBuffer *sortedBuffer;
+  Uint32 capacity;
+  // The layout actually in use; dense requests over GRID_MAX_DENSE_CELLS
+  // become sparse.
+  GridLayout layout;
+  GridUniforms uniforms;
+} NeighborGrid;
+
+// maxSmoothingRadius is the widest pair support and maxNumberDensity the most
+// particles per unit area at rest density, both over the scenes with a
+// pressure force. Fails when a buffer would pass 4 GiB.
+bool NeighborGrid_Init(NeighborGrid *grid,
+                       SDL_GPUDevice *device,
+                       SDL_GPUShaderFormat shaderFormat,
+                       Uint32 capacity,
+                       Uint32 numScenes,
+                       const GridBounds *bounds,
+                       float maxSmoothingRadius,
+                       float maxNumberDensity,
+                       const KernelConfig *config);
+
+void NeighborGrid_Destroy(NeighborGrid *grid, SDL_GPUDevice *device);
+
+// Writes the grid's storage bindings into bindings[SIM_BINDING_GRID] and
+// bindings[SIM_BINDING_GRID_SORTED].
+void NeighborGrid_FillBindings(const NeighborGrid *grid,
+                               SDL_GPUStorageBufferReadWriteBinding *bindings);
+
+// Pushes the grid uniforms (slot 1) for the compute passes recorded
+// afterwards.
+void NeighborGrid_PushUniforms(const NeighborGrid *grid,
+                               SDL_GPUCommandBuffer *cmdBuf);
+
+// Sorts the current live particles into cells and, with neighbour lists,
+// rebuilds them; both are skipped on the GPU while the lists are still
+// valid. The pool uniforms must be pushed first; indirectArgs is the pool's
+// indirect buffer.
+bool NeighborGrid_Build(const NeighborGrid *grid,
+                        SDL_GPUCommandBuffer *cmdBuf,
+                        const SDL_GPUStorageBufferReadWriteBinding *bindings,
+                        SDL_GPUBuffer *indirectArgs);
+
+#endif // GRID_H
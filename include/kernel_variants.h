@@ -0,0 +1,143 @@
+#ifndef KERNEL_VARIANTS_H
+#define KERNEL_VARIANTS_H
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// The density, force and integrate entry points are compiled once per
+// combination of the options below (see CMakeLists.txt), so the hot loops
+// never branch on mode flags. Enum values match the -D values passed to slangc.
+
+typedef enum SmoothingKernel {
+  SMOOTHING_KERNEL_POLY6 = 0,
+  SMOOTHING_KERNEL_SPIKY = 1,
+  SMOOTHING_KERNEL_WENDLAND = 2,
+  SMOOTHING_KERNEL_COUNT
+} SmoothingKernel;
+
+typedef enum BoundaryMode {
+  // Walls at the scene's domain that bounce with the scene's damping.
+  BOUNDARY_REFLECT = 0,
+  // Wraps around the domain, which every scene must share; neighbours are
+  // found across the seam.
+  BOUNDARY_PERIODIC = 1,
+  // No walls; particles leaving the scene's domain go back to the pool.
+  BOUNDARY_OPEN = 2,
+  BOUNDARY_MODE_COUNT
+} BoundaryMode;
+
+// SDL can't tell whether the device really supports half precision: on
+// Vulkan drivers without shaderFloat16 an fp16 pipeline may still be created
+// and then compute garbage. fp16 is therefore only used when asked for.
+typedef enum KernelPrecision {
+  KERNEL_PRECISION_FP32 = 0,
+  // Half-precision kernel evaluation with fp32 accumulation.
+  KERNEL_PRECISION_FP16 = 1,
+  // Let the startup benchmark pick between fp32 and fp16; only for devices
+  // known to support fp16 arithmetic.
+  KERNEL_PRECISION_AUTO = 2,
+} KernelPrecision;
+
+// How the density and force passes walk the neighbour grid.
+typedef enum NeighborMode {
+  // One thread per particle, each reading its neighbours from global memory.
+  NEIGHBOR_MODE_GLOBAL = 0,
+  // One workgroup per cell, sharing neighbour cells through groupshared
+  // tiles.
+  NEIGHBOR_MODE_TILED = 1,
+  // One thread per particle over a per-particle Verlet list, built with a
+  // skin margin and only rebuilt once something may have moved through it.
+  NEIGHBOR_MODE_LIST = 2,
+  // Let the startup benchmark pick among global, tiled and list, timing
+  // whole steps so list upkeep counts against lists.
+  NEIGHBOR_MODE_AUTO = 3,
+} NeighborMode;
+
+// How the neighbour grid stores its cells. The variants are specialized on
+// it; the grid build passes read it from the grid uniforms.
+typedef enum GridLayout {
+  // Every cell of the grid's bounds, for every scene. Falls back to sparse
+  // past GRID_MAX_DENSE_CELLS.
+  GRID_LAYOUT_DENSE = 0,
+  // Only occupied cells, hashed into a table sized by the particle capacity
+  // rather than the domain. Tiled neighbour mode needs the dense layout.
+  GRID_LAYOUT_SPARSE = 1,
+} GridLayout;
+
+#define KERNEL_NUM_GROUP_SIZES 3
+extern const Uint32 kKernelGroupSizes[KERNEL_NUM_GROUP_SIZES];
+
+// What the user asked for. Smoothing kernel and boundary change the results
+// and are always honoured; group size and neighbour mode (and, opted into,
+// precision) can be left to the benchmark.
+typedef struct KernelConfig {
+  SmoothingKernel smoothing;
+  BoundaryMode boundary;
+  KernelPrecision precision;
+  // 0 lets the benchmark pick one of kKernelGroupSizes.
+  Uint32 groupSize;
+  NeighborMode neighbors;
+  GridLayout gridLayout;
+  // Verlet skin for NEIGHBOR_MODE_LIST, as a fraction of the largest
+  // smoothing radius.
+  float neighborSkin;
+} KernelConfig;
+
+// One compiled specialization. density and force are the tiled or list
+// entry points when neighbors is NEIGHBOR_MODE_TILED or NEIGHBOR_MODE_LIST.
+typedef struct KernelVariant {
+  SDL_GPUComputePipeline *density;
+  SDL_GPUComputePipeline *force;
+  SDL_GPUComputePipeline *integrate;
+  SmoothingKernel smoothing;
+  BoundaryMode boundary;
+  KernelPrecision precision;
+  Uint32 groupSize;
+  NeighborMode neighbors;
+  GridLayout layout;
+} KernelVariant;
+
+// Spiky kernel, reflecting walls, dense grid, fp32, benchmarked group size
+// and neighbour mode.
+KernelConfig KernelConfig_Default(void);
+
+bool KernelVariants_ParseSmoothing(const char *name, SmoothingKernel *out);
+bool KernelVariants_ParseBoundary(const char *name, BoundaryMode *out);
+bool KernelVariants_ParsePrecision(const char *name, KernelPrecision *out);
+bool KernelVariants_ParseNeighbors(const char *name, NeighborMode *out);
+bool KernelVariants_ParseGridLayout(const char *name, GridLayout *out);
+
+// e.g. "tiled".
+const char *KernelVariants_NeighborsName(NeighborMode neighbors);
+
+// e.g. "spiky-reflect-dense-fp32-128".
+void KernelVariants_Describe(char *out,
+                             size_t outSize,
+                             SmoothingKernel smoothing,
+                             BoundaryMode boundary,
+                             GridLayout layout,
+                             KernelPrecision precision,
+                             Uint32 groupSize);
+
+// Loads the three pipelines of one specialization from assets/variants.
+// neighbors must not be AUTO, nor TILED with the sparse layout. Variants
+// the build left out fail without logging, with the reason in
+// SDL_GetError.
+// numReadWriteStorageBuffers and numUniformBuffers describe the shared
+// simulation layout.
+bool KernelVariant_Load(KernelVariant *variant,
+                        SDL_GPUDevice *device,
+                        SDL_GPUShaderFormat shaderFormat,
+                        SmoothingKernel smoothing,
+                        BoundaryMode boundary,
+                        GridLayout layout,
+                        KernelPrecision precision,
+                        Uint32 groupSize,
+                        NeighborMode neighbors,
+                        Uint32 numReadWriteStorageBuffers,
+                        Uint32 numUniformBuffers);
+
+void KernelVariant_Destroy(KernelVariant *variant, SDL_GPUDevice *device);
+
+#endif // KERNEL_VARIANTS_H
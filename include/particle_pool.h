@@ -0,0 +1,170 @@
+#ifndef PARTICLE_POOL_H
+#define PARTICLE_POOL_H
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define POOL_MAX_EMITTERS 4
+#define POOL_MAX_SINKS 4
+
+// Slots in the counter buffer. Keep in sync with particles.slang.
+#define POOL_COUNTER_ALIVE 0
+#define POOL_COUNTER_ALIVE_NEXT 1
+#define POOL_COUNTER_DEAD 2
+// Split requests queued this step (see refine.h); finalizeCS clears it.
+#define POOL_COUNTER_SPLIT 3
+// Neighbour-list bookkeeping (see grid.h): the largest distance, as float
+// bits, any particle has moved since the lists were built, and whether the
+// live set changed since then.
+#define POOL_COUNTER_MAX_MOVE 4
+#define POOL_COUNTER_GRID_DIRTY 5
+// Neighbours left out of full lists, summed over every list build so far.
+#define POOL_COUNTER_LIST_OVERFLOW 6
+#define POOL_COUNTER_COUNT 7
+
+// Byte offsets into the indirect argument buffer written by finalizeCS. The
+// first dispatch is sized for the selected kernel variant's group size, the
+// second for SIM_THREADGROUP_SIZE.
+#define POOL_DISPATCH_ARGS_OFFSET 0
+#define POOL_DRAW_ARGS_OFFSET 16
+#define POOL_FIXED_DISPATCH_ARGS_OFFSET 32
+// Neighbour grid build dispatches, written by gridGateCS instead: cell
+// clear, per-particle passes and scan blocks. Zero groups when the build is
+// skipped.
+#define POOL_GRID_CLEAR_ARGS_OFFSET 48
+#define POOL_GRID_PARTICLE_ARGS_OFFSET 60
+#define POOL_GRID_SCAN_ARGS_OFFSET 72
+// Tiled density and force passes, one workgroup per occupied cell, written
+// by gridScanBlocksCS when the grid is rebuilt.
+#define POOL_GRID_TILED_ARGS_OFFSET 84
+#define POOL_INDIRECT_ARGS_SIZE 96
+
+// Planes of the pool's list buffer (SIM_BINDING_POOL_LISTS), each one uint per
+// particle slot. The two alive lists ping-pong; PoolUniforms.aliveCurrent
+// says which is current.
+typedef enum PoolListPlane {
+  POOL_LIST_ALIVE_A = 0,
+  POOL_LIST_ALIVE_B,
+  POOL_LIST_DEAD,
+  // Slots that asked to be split this step, POOL_COUNTER_SPLIT long.
+  POOL_LIST_SPLIT,
+  POOL_LIST_COUNT,
+} PoolListPlane;
+
+// Spawns particles inside a disc at a steady rate. Velocities are in NDC per
+// frame, matching the Verlet encoding used by the compute shader.
+typedef struct ParticleEmitter {
+  float x;
+  float y;
+  float radius;
+  float velX;
+  float velY;
+  // Particles per frame; fractional rates accumulate across frames.
+  float rate;
+  // Scene the spawned particles belong to.
+  Uint32 scene;
+} ParticleEmitter;
+
+// Kills any particle that enters the disc.
+typedef struct ParticleSink {
+  float x;
+  float y;
+  float radius;
+} ParticleSink;
+
+// Uniform block pushed to every simulation pass. Mirrors PoolParams in
+// particles.slang, so only 16-byte vectors and scalars in groups of four.
+typedef struct PoolUniforms {
+  float emitterShape[POOL_MAX_EMITTERS][4];    // x, y, radius, unused
+  float emitterVelocity[POOL_MAX_EMITTERS][4]; // velX, velY, unused, unused
+  Uint32 emitterRange[POOL_MAX_EMITTERS][4];   // first spawn, count, scene
+  float sinks[POOL_MAX_SINKS][4];              // x, y, radius, unused
+  Uint32 numEmitters;
+  Uint32 numSinks;
+  Uint32 spawnTotal;
+  Uint32 frame;
+  Uint32 capacity;
+  // Workgroup size of the per-particle passes dispatched from the indirect
+  // arguments.
+  Uint32 dispatchGroupSize;
+  // PoolListPlane of the current alive list; the other one is next.
+  Uint32 aliveCurrent;
+  Uint32 pad2;
+} PoolUniforms;
+
+// Fixed-capacity particle pool living entirely on the GPU. Live particles are
+// tracked by index in a ping-ponged alive list and free slots in a dead list,
+// so emitters and sinks never reallocate or read back to the CPU. The live
+// count drives the next frame's indirect dispatch and draw.
+typedef struct ParticlePool {
+  SDL_GPUComputePipeline *emitPipeline;
+  SDL_GPUComputePipeline *finalizePipeline;
+  // Both alive lists and the dead list, as PoolListPlane planes.
+  SDL_GPUBuffer *listBuffer;
+  SDL_GPUBuffer *counterBuffer;
+  SDL_GPUBuffer *indirectBuffer;
+  Uint32 capacity;
+  // Plane holding the current live particles (POOL_LIST_ALIVE_A or _B).
+  PoolListPlane current;
+  // finalizeCS sizes the indirect dispatch for this many threads per group.
+  // Defaults to SIM_THREADGROUP_SIZE; the sim sets it to the selected
+  // kernel variant's group size.
+  Uint32 dispatchGroupSize;
+
+  ParticleEmitter emitters[POOL_MAX_EMITTERS];
+  float emitterAccum[POOL_MAX_EMITTERS];
+  int numEmitters;
+  ParticleSink sinks[POOL_MAX_SINKS];
+  int numSinks;
+
+  PoolUniforms uniforms;
+} ParticlePool;
+
+// Creates the pool buffers and uploads the initial state. Slots
+// [0, initialCount) start out alive; the rest go on the dead list.
+bool ParticlePool_Init(ParticlePool *pool,
+                       SDL_GPUDevice *device,
+                       SDL_GPUShaderFormat shaderFormat,
+                       const char *emitShaderPath,
+                       const char *finalizeShaderPath,
+                       Uint32 capacity,
+                       Uint32 initialCount);
+
+void ParticlePool_Destroy(ParticlePool *pool, SDL_GPUDevice *device);
+
+bool ParticlePool_AddEmitter(ParticlePool *pool, const ParticleEmitter *emitter);
+
+bool ParticlePool_AddSink(ParticlePool *pool, const ParticleSink *sink);
+
+// Schedules this frame's spawns and pushes the pool uniforms (slot 0) for the
+// compute passes recorded afterwards.
+void ParticlePool_PushUniforms(ParticlePool *pool, SDL_GPUCommandBuffer *cmdBuf);
+
+// Writes the pool's storage bindings into bindings[SIM_BINDING_POOL_LISTS] and
+// bindings[SIM_BINDING_COUNTERS].
+void ParticlePool_FillBindings(const ParticlePool *pool,
+                               SDL_GPUStorageBufferReadWriteBinding *bindings);
+
+// Pops dead slots for this frame's spawns and appends them to the next alive
+// list. Must run after the simulation pass.
+bool ParticlePool_Emit(ParticlePool *pool,
+                       SDL_GPUCommandBuffer *cmdBuf,
+                       const SDL_GPUStorageBufferReadWriteBinding *bindings);
+
+// Promotes the next alive list to current, rewrites the indirect arguments and
+// swaps the alive lists.
+bool ParticlePool_Finalize(ParticlePool *pool,
+                           SDL_GPUCommandBuffer *cmdBuf,
+                           const SDL_GPUStorageBufferReadWriteBinding *bindings);
+
+// Plane of the list buffer holding the live particles after
+// ParticlePool_Finalize, for the vertex shader and readbacks.
+// Dispatch covering threads at the given group size, split into rows of
+// SIM_DISPATCH_ROW_GROUPS groups; matches writeDispatch in particles.slang.
+SDL_GPUIndirectDispatchCommand ParticlePool_DispatchSize(Uint32 threads,
+                                                         Uint32 groupSize);
+
+PoolListPlane ParticlePool_GetAlivePlane(const ParticlePool *pool);
+
+#endif // PARTICLE_POOL_H
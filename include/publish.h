@@ -0,0 +1,154 @@
+#ifndef PUBLISH_H
+#define PUBLISH_H
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "readback.h"
+#include "sim.h"
+
+// Shared-memory layout, for readers in other processes. Everything is
+// little-endian and naturally aligned:
+//
+//   PublishHeader
+//   slot 0 .. numSlots-1, slotSize bytes each, starting at headerSize:
+//     PublishSlotHeader
+//     PUBLISH_BLOCK_COUNT blocks of capacity 4-byte values, blockSize apart
+//
+// Only the first count entries of each block are meaningful: the live
+// particles, packed in alive-list order.
+#define PUBLISH_MAGIC 0x48505353u // "SSPH"
+#define PUBLISH_VERSION 1
+
+typedef enum PublishBlock {
+  // float32 position in NDC.
+  PUBLISH_BLOCK_X = 0,
+  PUBLISH_BLOCK_Y,
+  // float32 velocity in NDC per frame.
+  PUBLISH_BLOCK_VX,
+  PUBLISH_BLOCK_VY,
+  PUBLISH_BLOCK_MASS,
+  PUBLISH_BLOCK_DENSITY,
+  // uint32 scene index.
+  PUBLISH_BLOCK_SCENE,
+  PUBLISH_BLOCK_COUNT,
+} PublishBlock;
+
+typedef struct PublishHeader {
+  Uint32 magic;
+  Uint32 version;
+  Uint32 numSlots;
+  Uint32 capacity;
+  Uint32 headerSize;
+  Uint32 slotSize;
+  Uint32 blockSize;
+  // Frames published so far; the newest is in slot (published - 1) %
+  // numSlots. Bumped after the slot is complete.
+  SDL_AtomicU32 published;
+} PublishHeader;
+
+// Seqlock: the writer makes sequence odd, fills the slot and makes it even
+// again. A reader copies what it needs, then accepts the copy only if
+// sequence was even and unchanged across it. With several slots the writer
+// is rarely in the one a reader wants.
+typedef struct PublishSlotHeader {
+  SDL_AtomicU32 sequence;
+  Uint32 count;
+  Uint64 frame;
+} PublishSlotHeader;
+
+// Snapshots between the GPU and the writer, as for capture.
+#define PUBLISH_RING_SLOTS 3
+
+typedef struct PublishSettings {
+  // Shared-memory object name, e.g. "/sdl_sph".
+  const char *name;
+  // Publish every this many steps; 0 means every step.
+  Uint32 every;
+} PublishSettings;
+
+// Streams the particle state into a single-writer, multi-reader ring in
+// shared memory. publishPackCS gathers the live particles into packBuffer,
+// and only the rows a frame is expected to need are downloaded through a
+// ReadbackRing and written by its worker thread, so the frame loop never
+// waits: frames that find every download slot busy are skipped, as are
+// frames whose alive count outgrew their download.
+typedef struct Publisher {
+  Uint32 every;
+  Uint64 steps;
+  Uint32 capacity;
+
+  SDL_GPUDevice *device;
+  SDL_GPUComputePipeline *packPipeline;
+  // PUBLISH_BLOCK_COUNT capacity-long blocks, in PublishBlock order.
+  SDL_GPUBuffer *packBuffer;
+  ReadbackRing ring;
+  // Rows downloaded per block by each ring slot, in commit order; the ring
+  // consumes slots in the same order.
+  Uint32 rows[PUBLISH_RING_SLOTS];
+  Uint32 commits;
+  Uint32 consumed;
+  // Alive count of the last downloaded frame, which sizes the next download.
+  SDL_AtomicU32 lastAlive;
+  Uint32 truncated;
+  // Mapped shared memory and the writer's next slot.
+  Uint8 *shared;
+  size_t sharedSize;
+  Uint32 nextSlot;
+  Uint32 published;
+  char name[64];
+  // Platform handle of the mapping (a file mapping on Windows).
+  void *handle;
+} Publisher;
+
+bool Publisher_Init(Publisher *publisher,
+                    SDL_GPUDevice *device,
+                    SDL_GPUShaderFormat shaderFormat,
+                    const Sim *sim,
+                    const PublishSettings *settings);
+
+// Flushes pending snapshots, then unmaps and unlinks the shared memory.
+void Publisher_Destroy(Publisher *publisher);
+
+// Call once per simulation step after submitting it. Every Nth step records
+// the pack pass and its download in a command buffer of its own. Never
+// blocks.
+bool Publisher_Step(Publisher *publisher,
+                    SDL_GPUDevice *device,
+                    const Sim *sim);
+
+// Read side of the ring, mapped read-only. The reference for readers in
+// other processes, and what --publish-read uses to check a running writer.
+typedef struct PublishReader {
+  const Uint8 *shared;
+  size_t sharedSize;
+  // Copied from the header once it validated.
+  Uint32 numSlots;
+  Uint32 capacity;
+  Uint32 headerSize;
+  Uint32 slotSize;
+  Uint32 blockSize;
+  void *handle;
+} PublishReader;
+
+// Fails unless the object carries PUBLISH_MAGIC and PUBLISH_VERSION and is
+// as large as its header says.
+bool PublishReader_Open(PublishReader *reader, const char *name);
+
+void PublishReader_Close(PublishReader *reader);
+
+// Copies the newest complete frame. blocks[b] receives the packed values of
+// block b and must hold reader->capacity entries. Retries while the writer
+// is in the slot (odd or changed sequence); returns false when nothing has
+// been published yet or no consistent copy was made.
+bool PublishReader_ReadLatest(const PublishReader *reader,
+                              Uint32 *const blocks[PUBLISH_BLOCK_COUNT],
+                              Uint32 *outCount,
+                              Uint64 *outFrame);
+
+// Self-check for --publish-read: waits for a frame on the named ring and
+// logs its size and mean position.
+bool PublishReader_Check(const char *name);
+
+#endif // PUBLISH_H
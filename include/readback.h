@@ -0,0 +1,77 @@
+#ifndef READBACK_H
+#define READBACK_H
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define READBACK_MAX_SLOTS 8
+
+// Called on the worker thread with a mapped download slot. The pointer is
+// only valid for the duration of the call.
+typedef void (*ReadbackConsumeFn)(void *userdata, const Uint8 *data,
+                                  Uint32 size, Uint64 frame);
+
+typedef enum ReadbackSlotState {
+  READBACK_SLOT_FREE,
+  // Download recorded and submitted; waiting on the fence.
+  READBACK_SLOT_IN_FLIGHT,
+  // Mapped and queued for (or being processed by) the worker thread.
+  READBACK_SLOT_QUEUED,
+  // Worker is done; main thread still has to unmap and recycle it.
+  READBACK_SLOT_DONE,
+} ReadbackSlotState;
+
+typedef struct ReadbackSlot {
+  SDL_GPUTransferBuffer *transfer;
+  SDL_GPUFence *fence;
+  const Uint8 *mapped;
+  Uint64 frame;
+  ReadbackSlotState state;
+} ReadbackSlot;
+
+// Ring of download transfer buffers drained by a worker thread. All GPU
+// calls (fence queries, map/unmap) stay on the thread that owns the device;
+// the worker only ever sees mapped memory. Nothing here waits on the GPU
+// except Readback_Destroy.
+typedef struct ReadbackRing {
+  SDL_GPUDevice *device;
+  ReadbackSlot slots[READBACK_MAX_SLOTS];
+  int numSlots;
+  Uint32 slotSize;
+  // Next slot handed out by Readback_Acquire and next slot to be mapped.
+  // Slots are used strictly round-robin so output stays in frame order.
+  int head;
+  int mapTail;
+
+  ReadbackConsumeFn consume;
+  void *userdata;
+  SDL_Thread *thread;
+  SDL_Mutex *lock;
+  SDL_Condition *wake;
+  bool quit;
+} ReadbackRing;
+
+bool Readback_Init(ReadbackRing *ring,
+                   SDL_GPUDevice *device,
+                   Uint32 slotSize,
+                   int numSlots,
+                   ReadbackConsumeFn consume,
+                   void *userdata,
+                   const char *threadName);
+
+// Flushes every outstanding slot through the consumer, then stops the worker.
+void Readback_Destroy(ReadbackRing *ring);
+
+// Maps finished downloads and recycles slots the worker is done with.
+// Never blocks.
+void Readback_Poll(ReadbackRing *ring);
+
+// Returns the transfer buffer of the next slot, or NULL when every slot is
+// still busy. The caller records its download into it and then calls
+// Readback_Commit with the fence of the submitted command buffer.
+SDL_GPUTransferBuffer *Readback_Acquire(ReadbackRing *ring);
+
+void Readback_Commit(ReadbackRing *ring, SDL_GPUFence *fence, Uint64 frame);
+
+#endif // READBACK_H
@@ -0,0 +1,47 @@
+#ifndef REFINE_H
+#define REFINE_H
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+
+// Adaptive particle resolution for scenes with SceneParams.maxMass > 0.
+// Particles near a free surface (density below surfaceRatio * restDensity),
+// a reflecting wall or a sink split into two half-mass children; calm
+// interior particles merge in mutually-nearest pairs. Mass, and with it the
+// support radius, lives in SIM_PLANE_MASS, so both operations conserve mass
+// and momentum exactly.
+//
+// Per step:
+//  - ParticleRefiner_Merge after the force pass: every particle proposes its
+//    nearest mergeable neighbour (GRID_PLANE_PARTNER), then the lower slot of
+//    each mutual pair absorbs the other. The integrate pass releases the
+//    absorbed slots.
+//  - The integrate pass queues split requests (POOL_LIST_SPLIT).
+//  - ParticleRefiner_Split after emission: each request pops a dead slot
+//    below the ones emitCS took and moves half the mass into it. Requests
+//    without a free slot are dropped.
+typedef struct ParticleRefiner {
+  SDL_GPUComputePipeline *proposePipeline;
+  SDL_GPUComputePipeline *mergePipeline;
+  SDL_GPUComputePipeline *splitPipeline;
+} ParticleRefiner;
+
+bool ParticleRefiner_Init(ParticleRefiner *refiner,
+                          SDL_GPUDevice *device,
+                          SDL_GPUShaderFormat shaderFormat);
+
+void ParticleRefiner_Destroy(ParticleRefiner *refiner, SDL_GPUDevice *device);
+
+// Pool and grid uniforms must be pushed first; indirectArgs is the pool's
+// indirect buffer.
+bool ParticleRefiner_Merge(const ParticleRefiner *refiner,
+                           SDL_GPUCommandBuffer *cmdBuf,
+                           const SDL_GPUStorageBufferReadWriteBinding *bindings,
+                           SDL_GPUBuffer *indirectArgs);
+
+bool ParticleRefiner_Split(const ParticleRefiner *refiner,
+                           SDL_GPUCommandBuffer *cmdBuf,
+                           const SDL_GPUStorageBufferReadWriteBinding *bindings,
+                           SDL_GPUBuffer *indirectArgs);
+
+#endif // REFINE_H
@@ -5,6 +5,19 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+// Sim buffers a draw reads. The vertex shader walks the alive list plane of
+// lists and reads positions from the attribute planes.
+typedef struct RenderParticles {
+  // SIM_BINDING_PARTICLES and SIM_BINDING_POOL_LISTS.
+  SDL_GPUBuffer *attributes;
+  SDL_GPUBuffer *lists;
+  Uint32 capacity;
+  // PoolListPlane holding the live particles.
+  Uint32 alivePlane;
+  SDL_GPUBuffer *indirectArgs;
+  Uint32 drawArgsOffset;
+} RenderParticles;
+
 typedef struct RenderState {
   SDL_GPUShader *vertexShader;
   SDL_GPUShader *fragmentShader;
@@ -19,11 +32,26 @@ bool Render_Init(RenderState *state,
 
 void Render_Destroy(RenderState *state, SDL_GPUDevice *device);
 
+// Draws the live particles into an arbitrary color target (R8G8B8A8).
+bool Render_DrawToTexture(RenderState *state,
+                          SDL_GPUCommandBuffer *cmdBuf,
+                          SDL_GPUTexture *target,
+                          Uint32 width,
+                          Uint32 height,
+                          const RenderParticles *particles);
+
+// Draws into the window's swapchain, waiting for it if necessary.
 bool Render_Draw(RenderState *state,
                  SDL_GPUCommandBuffer *cmdBuf,
                  SDL_Window *window,
-                 SDL_GPUBuffer *xCurr,
-                 SDL_GPUBuffer *yCurr,
-                 int numParticles);
+                 const RenderParticles *particles);
+
+// Blits an offscreen frame to the window if a swapchain image is available
+// right now. Never waits.
+void Render_PreviewTexture(SDL_GPUCommandBuffer *cmdBuf,
+                           SDL_Window *window,
+                           SDL_GPUTexture *source,
+                           Uint32 width,
+                           Uint32 height);
 
 #endif // RENDER_H
@@ -7,4 +7,15 @@
 
 bool LoadShaderFile(const char *path, Uint8 **outBuffer, size_t *outSize);
 
+// Loads a compiled compute shader and builds a pipeline with only read-write
+// storage buffers and uniform buffers, which is all the simulation uses.
+SDL_GPUComputePipeline *CreateComputePipelineFromFile(
+    SDL_GPUDevice *device, SDL_GPUShaderFormat shaderFormat, const char *path,
+    const char *entrypoint, Uint32 numReadWriteStorageBuffers,
+    Uint32 numUniformBuffers, Uint32 threadCountX);
+
+// Formats "assets/particles.<stage>.<spv|msl>" for the given shader format.
+void BuildShaderPath(char *out, size_t outSize, const char *stage,
+                     SDL_GPUShaderFormat shaderFormat);
+
 #endif // SHADER_UTILS_H
@@ -0,0 +1,138 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "grid.h"
+#include "kernel_variants.h"
+#include "particle_pool.h"
+#include "refine.h"
+#include "sim_layout.h"
+
+// Per-scene parameters, indexed by each particle's scene id. Mirrors
+// SceneParams in particles.slang (std430, scalars only).
+typedef struct SceneParams {
+  // Positions, lengths and speeds are in world units, which match NDC in the
+  // interactive window.
+  //
+  // Acceleration per frame squared.
+  float gravityX;
+  float gravityY;
+  // Fraction of normal velocity kept when hitting the domain walls.
+  float bounce;
+  // Fraction of velocity lost per frame.
+  float drag;
+  // SPH support radius.
+  float smoothingRadius;
+  // Density the pressure force relaxes towards, in mass per unit area.
+  float restDensity;
+  // Pressure per unit of excess density; 0 turns the pressure force off.
+  float stiffness;
+  // Adaptive resolution (see refine.h), off when maxMass is 0. A particle of
+  // mass m has support radius smoothingRadius * sqrt(m), so mass 1 is the
+  // base resolution. Splits never go below minMass, merges never above
+  // maxMass.
+  float minMass;
+  float maxMass;
+  // Below this fraction of restDensity a particle is at a free surface and
+  // gets split.
+  float surfaceRatio;
+  // Interior particles slower than this (per frame) may merge.
+  float calmSpeed;
+  // The scene's box: walls for BOUNDARY_REFLECT, the wrapped cell for
+  // BOUNDARY_PERIODIC (where every scene must share one box), and where
+  // particles are released for BOUNDARY_OPEN. Needs max > min on both axes.
+  float domainMinX;
+  float domainMinY;
+  float domainMaxX;
+  float domainMaxY;
+  float pad;
+} SceneParams;
+
+// Particles to place in slots [0, count) at startup. Every other slot starts
+// on the pool's dead list.
+typedef struct SimInitialState {
+  const float *xCurr;
+  const float *yCurr;
+  const float *xPrev;
+  const float *yPrev;
+  const float *mass;
+  const Uint32 *sceneId;
+  Uint32 count;
+  const SceneParams *scenes;
+  Uint32 numScenes;
+} SimInitialState;
+
+// Host view of a downloaded snapshot. Arrays are indexed by particle slot;
+// alive[0 .. aliveCount) lists the live slots.
+typedef struct SimSnapshot {
+  Uint32 aliveCount;
+  const Uint32 *alive;
+  const float *xCurr;
+  const float *yCurr;
+  const float *xPrev;
+  const float *yPrev;
+  const float *mass;
+  const float *density;
+  const Uint32 *sceneId;
+  // Neighbours dropped from full neighbour lists so far (see grid.h).
+  Uint32 listOverflow;
+} SimSnapshot;
+
+// The particle simulation: SoA storage sized to a fixed capacity, the scene
+// table, the particle pool, the neighbour grid and the compute pipelines that
+// advance them. Any number of independent scenes share the buffers and step
+// in one dispatch.
+typedef struct Sim {
+  // Density, force and integrate pipelines picked at startup.
+  KernelVariant kernels;
+  // Indexed by SimBinding; the pool's and grid's slots are left NULL and
+  // filled from them when binding.
+  SDL_GPUBuffer *buffers[SIM_BINDING_COUNT];
+  ParticlePool pool;
+  NeighborGrid grid;
+  // Only created when some scene has adaptive resolution.
+  ParticleRefiner refiner;
+  bool adaptive;
+  Uint32 capacity;
+  Uint32 numScenes;
+  // Union of the scenes' domains, which the grid spans.
+  GridBounds bounds;
+} Sim;
+
+bool Sim_Init(Sim *sim,
+              SDL_GPUDevice *device,
+              SDL_GPUShaderFormat shaderFormat,
+              Uint32 capacity,
+              const SimInitialState *initial,
+              const KernelConfig *kernelConfig);
+
+void Sim_Destroy(Sim *sim, SDL_GPUDevice *device);
+
+// Records one simulation step: neighbour grid build, SPH density and force,
+// merging, integration, emission, splitting and pool finalize.
+bool Sim_Step(Sim *sim, SDL_GPUCommandBuffer *cmdBuf);
+
+SDL_GPUBuffer *Sim_GetBuffer(const Sim *sim, SimBinding binding);
+
+// Bytes needed for Sim_RecordSnapshot.
+Uint32 Sim_SnapshotSize(const Sim *sim);
+
+// Records a download of the full particle state into a transfer buffer of at
+// least Sim_SnapshotSize bytes.
+void Sim_RecordSnapshot(const Sim *sim,
+                        SDL_GPUCopyPass *copyPass,
+                        SDL_GPUTransferBuffer *transfer);
+
+// Points a SimSnapshot at mapped snapshot memory.
+void Sim_ParseSnapshot(Uint32 capacity, const Uint8 *data, SimSnapshot *out);
+
+// Blocking download for offline tools. The returned buffer backs every
+// pointer in the snapshot; release it with SDL_free.
+Uint8 *Sim_DownloadSnapshot(const Sim *sim,
+                            SDL_GPUDevice *device,
+                            SimSnapshot *out);
+
+#endif // SIM_H
@@ -0,0 +1,56 @@
+#ifndef SIM_LAYOUT_H
+#define SIM_LAYOUT_H
+
+// Storage buffer slots shared by every simulation compute pipeline. The order
+// must match the [[vk::binding]] declarations in assets/particles.slang, since
+// the Metal backend assigns buffer indices in declaration order.
+//
+// SDL caps a compute pass at 8 read-write storage buffers, so per-particle
+// arrays of the same type share a buffer as capacity-sized planes (see
+// SimPlane and friends below) instead of taking a slot each. New per-particle
+// data should become a plane, not a binding.
+typedef enum SimBinding {
+  // Float planes, indexed by SimPlane.
+  SIM_BINDING_PARTICLES = 0,
+  // Pool lists (uint planes, indexed by PoolListPlane).
+  SIM_BINDING_POOL_LISTS,
+  SIM_BINDING_COUNTERS,
+  // Scene index per particle and the per-scene parameter table, so many
+  // independent simulations can share the buffers and one dispatch.
+  SIM_BINDING_SCENE_ID,
+  SIM_BINDING_SCENE_PARAMS,
+  // Neighbour grid: per-cell counts and starts followed by uint planes
+  // (GridPlane), then the cell-sorted particle copies (SortedPlane).
+  SIM_BINDING_GRID,
+  SIM_BINDING_GRID_SORTED,
+  // Number of slots bound by every simulation pass.
+  SIM_BINDING_COUNT,
+  // Only bound by the pool finalize and grid gate passes: the same buffer is
+  // consumed as indirect arguments elsewhere, so it can't sit in the other
+  // passes. The publisher's pack pass binds its own output here.
+  SIM_BINDING_INDIRECT_ARGS = SIM_BINDING_COUNT,
+} SimBinding;
+
+// Planes of SIM_BINDING_PARTICLES, each one float per particle slot.
+typedef enum SimPlane {
+  SIM_PLANE_X_CURR = 0,
+  SIM_PLANE_Y_CURR,
+  SIM_PLANE_X_PREV,
+  SIM_PLANE_Y_PREV,
+  SIM_PLANE_MASS,
+  SIM_PLANE_DENSITY,
+  SIM_PLANE_COUNT,
+} SimPlane;
+
+// Threadgroup width of emitCS and the grid build passes, and of the
+// per-particle passes until a kernel variant is selected.
+#define SIM_THREADGROUP_SIZE 64
+
+// 1D dispatches over more groups than this are split into rows of it along
+// Y, so groupcount_x stays within the 65535 Vulkan guarantees however large
+// the batch. Shaders recover the linear index as
+// id.y * SIM_DISPATCH_ROW_GROUPS * groupSize + id.x (threadIndex in
+// particles.slang).
+#define SIM_DISPATCH_ROW_GROUPS 32768
+
+#endif // SIM_LAYOUT_H
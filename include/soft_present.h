@@ -0,0 +1,56 @@
+#ifndef SOFT_PRESENT_H
+#define SOFT_PRESENT_H
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+
+#include "readback.h"
+#include "sim.h"
+#include "soft_render.h"
+
+// Shows the simulation in a window without a GPU swapchain: the GPU device
+// only runs compute, the window is never claimed for it and nothing goes
+// through the graphics pipeline. This is not GPU-less: the simulation still
+// needs an SDL GPU device with compute support. Snapshots are downloaded through a
+// ReadbackRing, drawn by a SoftRenderer on its worker thread and presented
+// through SDL_Renderer's software backend, so the frame loop never waits on
+// the GPU. Without a swapchain to wait on, the simulation is paced by the
+// download ring instead (see SoftPresent_Ready).
+typedef struct SoftPresenter {
+  SDL_Renderer *renderer;
+  SDL_Texture *texture;
+  // Drawn on the readback worker; must stay in place, see SoftRender_Init.
+  SoftRenderer soft;
+  ReadbackRing ring;
+  Uint32 capacity;
+  Uint64 steps;
+
+  // Latest finished frame, handed from the worker to the main thread.
+  SDL_Mutex *lock;
+  Uint32 *frame;
+  bool frameReady;
+} SoftPresenter;
+
+// Must be initialised in place. The window must not be claimed by a GPU
+// device. numThreads is as for SoftRender_Init.
+bool SoftPresent_Init(SoftPresenter *presenter,
+                      SDL_GPUDevice *device,
+                      SDL_Window *window,
+                      const Sim *sim,
+                      int numThreads);
+
+// Flushes pending snapshots, then releases the renderer.
+void SoftPresent_Destroy(SoftPresenter *presenter);
+
+// True when a download slot is free for the next step. Also presents the
+// newest frame the worker has finished.
+bool SoftPresent_Ready(SoftPresenter *presenter);
+
+// Call once per simulation step after submitting it. Records a snapshot
+// download in a command buffer of its own; steps that find every slot busy
+// are not shown. Never blocks on the GPU.
+bool SoftPresent_Step(SoftPresenter *presenter,
+                      SDL_GPUDevice *device,
+                      const Sim *sim);
+
+#endif // SOFT_PRESENT_H
@@ -0,0 +1,85 @@
+#ifndef SOFT_RENDER_H
+#define SOFT_RENDER_H
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+
+// Edge length in pixels of the square tiles the framebuffer is split into.
+// Each tile is splatted in a per-thread buffer small enough to stay in cache,
+// then streamed out to the framebuffer, so no two threads ever touch the same
+// pixel and nothing is locked per pixel.
+#define SOFT_RENDER_TILE_SIZE 64
+
+// One rendering thread and its private tile buffer.
+typedef struct SoftRenderWorker {
+  struct SoftRenderer *renderer;
+  // NULL for the calling thread, which is always workers[0].
+  SDL_Thread *thread;
+  Uint32 *tile;
+} SoftRenderWorker;
+
+// CPU point renderer for machines without a usable GPU swapchain. Draws the
+// same picture as mainVS/mainPS: square points in NDC, y up.
+typedef struct SoftRenderer {
+  int width;
+  int height;
+  // Pixels per framebuffer row; width rounded up to a whole SIMD vector.
+  int pitch;
+  // RGBA32 (bytes R, G, B, A in memory), 16-byte aligned.
+  Uint32 *pixels;
+
+  // Drawing style; defaults match the GPU path (white 4px points on black).
+  // Points are added with saturation, so a dimmer color shows density.
+  Uint32 background;
+  Uint32 color;
+  int pointSize;
+
+  int tilesX;
+  int tilesY;
+
+  // Per-frame point data: top-left pixel of each point, then the points
+  // binned by tile (tileStart has one entry per tile plus a terminator).
+  int *pointX;
+  int *pointY;
+  Uint32 pointCapacity;
+  Uint32 *tileStart;
+  Uint32 *tileFill;
+  Uint32 *binned;
+  Uint32 binnedCapacity;
+
+  // The calling thread renders tiles too, as workers[0].
+  SoftRenderWorker *workers;
+  int numWorkers;
+  SDL_Mutex *lock;
+  SDL_Condition *wake;
+  SDL_Condition *done;
+  Uint64 generation;
+  int busy;
+  bool quit;
+  SDL_AtomicInt nextTile;
+} SoftRenderer;
+
+// numThreads counts the caller; 0 uses every logical core. Must be
+// initialised in place, since the workers keep a pointer to it.
+bool SoftRender_Init(SoftRenderer *renderer,
+                     int width,
+                     int height,
+                     int numThreads);
+
+void SoftRender_Destroy(SoftRenderer *renderer);
+
+// Rasterizes one frame. Positions are NDC; indices selects which entries of
+// x/y to draw, or NULL to draw x[0 .. count) and y[0 .. count). Blocks until
+// every tile is drawn: the caller renders tiles alongside the workers, so
+// call it from a thread that may wait (SoftPresenter uses its readback
+// worker).
+bool SoftRender_Draw(SoftRenderer *renderer,
+                     const float *x,
+                     const float *y,
+                     const Uint32 *indices,
+                     Uint32 count);
+
+// Writes the last frame as a binary PPM (P6).
+bool SoftRender_WritePPM(const SoftRenderer *renderer, const char *path);
+
+#endif // SOFT_RENDER_H
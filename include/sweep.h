@@ -0,0 +1,48 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+
+#include "kernel_variants.h"
+
+// Frames drawn on the CPU (see soft_render.h) for machines with no display.
+// Each scene is written as <directory>/scene<S>_frame<F>.ppm.
+typedef struct SweepRenderSettings {
+  const char *directory;
+  int width;
+  int height;
+  // Also render every this many frames; 0 renders only the final frame.
+  Uint32 every;
+  // Rendering threads; 0 uses every logical core.
+  int threads;
+} SweepRenderSettings;
+
+// Headless parameter sweep. Every scene in the sweep file is packed into one
+// Sim and advanced by the same dispatches, then per-scene statistics are
+// written as CSV.
+//
+// Sweep file format, one directive per line, '#' starts a comment:
+//
+//   frames 600
+//   scene particles=10000 gravity=0,-0.00002 bounce=0.9 drag=0.001 speed=0.004 seed=7
+//   scene particles=4000 smoothing=0.05 rest_density=1000 stiffness=0.00002
+//   scene particles=4000 stiffness=0.00002 min_mass=0.25 max_mass=4
+//   scene particles=4000 stiffness=0.00002 min_mass=0.01 max_mass=4 capacity=40000
+//   scene particles=20000 smoothing=0.05 domain=-4,-1,4,1
+//
+// Every scene key is optional; see SweepScene in sweep.c for the defaults.
+// domain=minX,minY,maxX,maxY sets the scene's box (the NDC box by default);
+// particles start spread over it. Frames still show the NDC box.
+// Adaptive scenes (max_mass > 0) reserve pool slots for splitting down to
+// min_mass, at most capacity= slots when given.
+// All scenes share one kernel variant. outPath may be NULL to write the
+// results to stdout; render may be NULL to skip frame output.
+bool Sweep_Run(SDL_GPUDevice *device,
+               SDL_GPUShaderFormat shaderFormat,
+               const KernelConfig *kernels,
+               const char *sweepPath,
+               const char *outPath,
+               const SweepRenderSettings *render);
+
+#endif // SWEEP_H
@@ -0,0 +1,222 @@
+#include "capture.h"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+// Frames queued between the GPU and the writer. Three is enough to cover one
+// frame in flight on the GPU while the writer is busy with the previous two.
+#define CAPTURE_RING_SLOTS 3
+
+bool Capture_ParseFormat(const char *name, CaptureFormat *outFormat) {
+  if (SDL_strcmp(name, "raw") == 0) {
+    *outFormat = CAPTURE_FORMAT_RAW;
+    return true;
+  }
+  if (SDL_strcmp(name, "y4m") == 0) {
+    *outFormat = CAPTURE_FORMAT_Y4M;
+    return true;
+  }
+  return false;
+}
+
+// Converts RGBA8 to planar BT.601 limited-range YCbCr 4:4:4.
+static void ConvertToYUV444(const Uint8 *rgba, Uint32 numPixels, Uint8 *planes) {
+  Uint8 *yPlane = planes;
+  Uint8 *uPlane = planes + numPixels;
+  Uint8 *vPlane = planes + 2 * (size_t)numPixels;
+  for (Uint32 i = 0; i < numPixels; i++) {
+    int r = rgba[4 * i + 0];
+    int g = rgba[4 * i + 1];
+    int b = rgba[4 * i + 2];
+    // Offsets are folded in before the shift so every term stays positive.
+    yPlane[i] = (Uint8)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+    uPlane[i] = (Uint8)((-38 * r - 74 * g + 112 * b + 128 + (128 << 8)) >> 8);
+    vPlane[i] = (Uint8)((112 * r - 94 * g - 18 * b + 128 + (128 << 8)) >> 8);
+  }
+}
+
+static void WriteCapturedFrame(void *userdata, const Uint8 *data, Uint32 size,
+                               Uint64 frame) {
+  (void)frame;
+  Capture *capture = (Capture *)userdata;
+  if (capture->writeFailed) {
+    return;
+  }
+
+  bool ok = true;
+  if (capture->format == CAPTURE_FORMAT_Y4M) {
+    const Uint32 numPixels = capture->width * capture->height;
+    ConvertToYUV444(data, numPixels, capture->planes);
+    ok = fputs("FRAME\n", capture->out) >= 0 &&
+         fwrite(capture->planes, 1, 3 * (size_t)numPixels, capture->out) ==
+             3 * (size_t)numPixels;
+  } else {
+    ok = fwrite(data, 1, size, capture->out) == size;
+  }
+
+  if (!ok) {
+    // Typically the consumer on the other end of a pipe went away. Stop
+    // writing but keep the frame loop running.
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Capture write failed; dropping remaining frames");
+    capture->writeFailed = true;
+  }
+}
+
+static FILE *OpenCaptureOutput(const char *path, bool *outIsPipe) {
+  *outIsPipe = false;
+  if (SDL_strcmp(path, "-") == 0) {
+    return stdout;
+  }
+  if (path[0] == '|') {
+    *outIsPipe = true;
+    return popen(path + 1, "w");
+  }
+  return fopen(path, "wb");
+}
+
+static void CloseCaptureOutput(Capture *capture) {
+  if (capture->out == NULL) {
+    return;
+  }
+  if (capture->isPipe) {
+    pclose(capture->out);
+  } else if (capture->out == stdout) {
+    fflush(stdout);
+  } else {
+    fclose(capture->out);
+  }
+  capture->out = NULL;
+}
+
+bool Capture_Init(Capture *capture, SDL_GPUDevice *device,
+                  const CaptureSettings *settings) {
+  SDL_zerop(capture);
+  // One RGBA frame per readback slot; transfer buffer sizes are 32-bit.
+  const Uint64 frameSize = (Uint64)settings->width * settings->height * 4;
+  if (settings->width == 0 || settings->height == 0 ||
+      frameSize > SDL_MAX_UINT32) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Invalid capture size %ux%u",
+                 settings->width, settings->height);
+    return false;
+  }
+  capture->width = settings->width;
+  capture->height = settings->height;
+  capture->fps = settings->fps > 0 ? settings->fps : 60;
+  capture->format = settings->format;
+  capture->maxFrames = settings->maxFrames;
+
+  // Same format as the particle pipeline's color target. SAMPLER lets us blit
+  // it to the window for a preview.
+  capture->texture = SDL_CreateGPUTexture(
+      device, &(SDL_GPUTextureCreateInfo){
+                  .type = SDL_GPU_TEXTURETYPE_2D,
+                  .format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
+                  .usage = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET |
+                           SDL_GPU_TEXTUREUSAGE_SAMPLER,
+                  .width = capture->width,
+                  .height = capture->height,
+                  .layer_count_or_depth = 1,
+                  .num_levels = 1});
+  if (capture->texture == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't create capture texture: %s", SDL_GetError());
+    return false;
+  }
+
+  if (capture->format == CAPTURE_FORMAT_Y4M) {
+    capture->planes =
+        (Uint8 *)SDL_malloc(3 * (size_t)capture->width * capture->height);
+    if (capture->planes == NULL) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Couldn't allocate capture conversion buffer");
+      Capture_Destroy(capture, device);
+      return false;
+    }
+  }
+
+  capture->out = OpenCaptureOutput(settings->path, &capture->isPipe);
+  if (capture->out == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't open capture output: %s",
+                 settings->path);
+    Capture_Destroy(capture, device);
+    return false;
+  }
+  if (capture->format == CAPTURE_FORMAT_Y4M) {
+    fprintf(capture->out, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C444\n",
+            capture->width, capture->height, capture->fps);
+  }
+
+  if (!Readback_Init(&capture->ring, device, (Uint32)frameSize,
+                     CAPTURE_RING_SLOTS, WriteCapturedFrame, capture,
+                     "capture-writer")) {
+    Capture_Destroy(capture, device);
+    return false;
+  }
+
+  SDL_Log("Capturing %ux%u %s frames to %s", capture->width, capture->height,
+          capture->format == CAPTURE_FORMAT_Y4M ? "y4m" : "raw RGBA",
+          settings->path);
+  return true;
+}
+
+void Capture_Destroy(Capture *capture, SDL_GPUDevice *device) {
+  if (capture == NULL || device == NULL) {
+    return;
+  }
+  // Drains every in-flight frame through the writer before we close.
+  Readback_Destroy(&capture->ring);
+  CloseCaptureOutput(capture);
+  if (capture->texture != NULL) {
+    SDL_ReleaseGPUTexture(device, capture->texture);
+    capture->texture = NULL;
+  }
+  SDL_free(capture->planes);
+  capture->planes = NULL;
+}
+
+bool Capture_Ready(Capture *capture) {
+  return Readback_Acquire(&capture->ring) != NULL;
+}
+
+bool Capture_Finished(const Capture *capture) {
+  return capture->maxFrames > 0 &&
+         capture->framesSubmitted >= capture->maxFrames;
+}
+
+bool Capture_SubmitFrame(Capture *capture, SDL_GPUCommandBuffer *cmdBuf) {
+  SDL_GPUTransferBuffer *transfer = Readback_Acquire(&capture->ring);
+  if (transfer == NULL) {
+    // Caller skipped Capture_Ready; submit the frame without capturing it.
+    SDL_SubmitGPUCommandBuffer(cmdBuf);
+    return true;
+  }
+
+  SDL_GPUCopyPass *copyPass = SDL_BeginGPUCopyPass(cmdBuf);
+  if (copyPass == NULL) {
+    SDL_Log("SDL_BeginGPUCopyPass (capture) failed: %s", SDL_GetError());
+    SDL_SubmitGPUCommandBuffer(cmdBuf);
+    return false;
+  }
+  SDL_GPUTextureRegion src = {.texture = capture->texture,
+                              .w = capture->width,
+                              .h = capture->height,
+                              .d = 1};
+  SDL_GPUTextureTransferInfo dst = {.transfer_buffer = transfer,
+                                    .offset = 0,
+                                    .pixels_per_row = capture->width,
+                                    .rows_per_layer = capture->height};
+  SDL_DownloadFromGPUTexture(copyPass, &src, &dst);
+  SDL_EndGPUCopyPass(copyPass);
+
+  SDL_GPUFence *fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdBuf);
+  if (fence == NULL) {
+    SDL_Log("SDL_SubmitGPUCommandBufferAndAcquireFence failed: %s",
+            SDL_GetError());
+    return false;
+  }
+  Readback_Commit(&capture->ring, fence, capture->framesSubmitted++);
+  return true;
+}
@@ -0,0 +1,298 @@
+#include "grid.h"
+
+#include "particle_pool.h"
+#include "shader_utils.h"
+#include "sim_layout.h"
+
+// Whole cells across extent, none narrower than radius, at most limit. Without
+// a radius (no pressure anywhere) one cell will do.
+static Uint32 CellsAcross(float extent, float radius, Uint32 limit) {
+  if (radius <= 0.0f) {
+    return 1;
+  }
+  return (Uint32)SDL_clamp(SDL_floorf(extent / radius), 1.0f, (float)limit);
+}
+
+// Threads per scan workgroup, each scanning GRID_SCAN_BLOCK / this many cells.
+#define GRID_SCAN_THREADS 256
+
+bool NeighborGrid_Init(NeighborGrid *grid, SDL_GPUDevice *device,
+                       SDL_GPUShaderFormat shaderFormat, Uint32 capacity,
+                       Uint32 numScenes, const GridBounds *bounds,
+                       float maxSmoothingRadius, float maxNumberDensity,
+                       const KernelConfig *config) {
+  SDL_zerop(grid);
+  grid->capacity = capacity;
+
+  const bool lists = config->neighbors == NEIGHBOR_MODE_LIST;
+  // Lists gather everything within the support radius plus the skin, so
+  // cells have to cover both.
+  const float skin =
+      lists ? SDL_max(config->neighborSkin, 0.0f) * maxSmoothingRadius : 0.0f;
+  const float searchRadius = maxSmoothingRadius + skin;
+
+  const float width = bounds->maxX - bounds->minX;
+  const float height = bounds->maxY - bounds->minY;
+
+  // Dense grids hold a block of cells per scene, which a big sweep at a
+  // small radius turns into millions of cells cleared every step.
+  grid->layout = config->gridLayout;
+  const Uint32 denseX =
+      CellsAcross(width, searchRadius, GRID_MAX_CELLS_PER_AXIS);
+  const Uint32 denseY =
+      CellsAcross(height, searchRadius, GRID_MAX_CELLS_PER_AXIS);
+  const Uint64 denseCells = (Uint64)denseX * denseY * numScenes;
+  if (grid->layout == GRID_LAYOUT_DENSE && denseCells > GRID_MAX_DENSE_CELLS) {
+    if (config->neighbors == NEIGHBOR_MODE_TILED) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "A dense grid of %llu cells is over the limit of %u, and "
+                   "tiled neighbour mode can't use the sparse layout",
+                   (unsigned long long)denseCells, GRID_MAX_DENSE_CELLS);
+      return false;
+    }
+    SDL_Log("A dense grid would need %llu cells; using the sparse layout",
+            (unsigned long long)denseCells);
+    grid->layout = GRID_LAYOUT_SPARSE;
+  }
+  const bool sparse = grid->layout == GRID_LAYOUT_SPARSE;
+  if (sparse && numScenes > GRID_MAX_SPARSE_SCENES) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "The sparse grid supports at most %d scenes, got %u",
+                 GRID_MAX_SPARSE_SCENES, numScenes);
+    return false;
+  }
+  GridUniforms *u = &grid->uniforms;
+  if (sparse) {
+    // Sparse cells past the bounds are hashed like any other, so the bounds
+    // only set the cell size and, for periodic domains, the wrap.
+    u->gridX = CellsAcross(width, searchRadius,
+                           GRID_MAX_SPARSE_CELLS_PER_AXIS);
+    u->gridY = CellsAcross(height, searchRadius,
+                           GRID_MAX_SPARSE_CELLS_PER_AXIS);
+  } else {
+    u->gridX = denseX;
+    u->gridY = denseY;
+  }
+  if (searchRadius > 0.0f && (u->gridX * searchRadius > width ||
+                              u->gridY * searchRadius > height)) {
+    SDL_Log("Search radius %g is below the grid resolution; "
+            "neighbours further than a cell apart are missed",
+            (double)searchRadius);
+  }
+  u->originX = bounds->minX;
+  u->originY = bounds->minY;
+  u->invCellSizeX = (float)u->gridX / width;
+  u->invCellSizeY = (float)u->gridY / height;
+  u->periodX = width;
+  u->periodY = height;
+  u->numScenes = numScenes;
+  u->boundary = (Uint32)config->boundary;
+  u->skin = skin;
+  if (lists) {
+    // Particles expected within the search radius of a particle at rest.
+    const float expected = maxNumberDensity * SDL_PI_F * searchRadius *
+                           searchRadius;
+    const float wanted = SDL_ceilf(GRID_NEIGHBOR_SLACK * expected);
+    if (wanted > (float)GRID_MAX_NEIGHBORS) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Neighbour lists would need %.0f entries per particle, "
+                   "over the limit of %d; use another neighbour mode",
+                   (double)wanted, GRID_MAX_NEIGHBORS);
+      return false;
+    }
+    u->maxNeighbors = SDL_max((Uint32)wanted, (Uint32)GRID_MIN_NEIGHBORS);
+  }
+  if (sparse) {
+    // At most capacity cells are occupied, so the table stays at most half
+    // full and probe runs short.
+    Uint32 tableSize = 64;
+    while (tableSize < 2 * capacity) {
+      tableSize *= 2;
+    }
+    u->numCells = tableSize;
+    u->tableMask = tableSize - 1;
+  } else {
+    u->numCells = u->gridX * u->gridY * numScenes;
+    u->tableMask = 0;
+  }
+  u->numScanBlocks = (u->numCells + GRID_SCAN_BLOCK - 1) / GRID_SCAN_BLOCK;
+
+  struct {
+    const char *stage;
+    const char *entrypoint;
+    Uint32 threadCount;
+    SDL_GPUComputePipeline **pipeline;
+  } stages[] = {
+      {"gridgate", "gridGateCS", 1, &grid->gatePipeline},
+      {"gridclear", "gridClearCS", SIM_THREADGROUP_SIZE, &grid->clearPipeline},
+      {"gridcount", "gridCountCS", SIM_THREADGROUP_SIZE, &grid->countPipeline},
+      {"gridscanreduce", "gridScanReduceCS", GRID_SCAN_THREADS,
+       &grid->scanReducePipeline},
+      {"gridscanblocks", "gridScanBlocksCS", GRID_SCAN_THREADS,
+       &grid->scanBlocksPipeline},
+      {"gridscandown", "gridScanDownCS", GRID_SCAN_THREADS,
+       &grid->scanDownPipeline},
+      {"gridscatter", "gridScatterCS", SIM_THREADGROUP_SIZE,
+       &grid->scatterPipeline},
+      {"gridlist", "gridListCS", SIM_THREADGROUP_SIZE, &grid->listPipeline},
+  };
+  for (size_t i = 0; i < SDL_arraysize(stages); i++) {
+    if (stages[i].pipeline == &grid->listPipeline && !lists) {
+      continue;
+    }
+    // The gate and the block scan also bind the pool's indirect buffer,
+    // like finalize.
+    const bool writesArgs = stages[i].pipeline == &grid->gatePipeline ||
+                            stages[i].pipeline == &grid->scanBlocksPipeline;
+    const Uint32 numReadWriteStorageBuffers =
+        writesArgs ? SIM_BINDING_COUNT + 1 : SIM_BINDING_COUNT;
+    char path[256];
+    BuildShaderPath(path, sizeof(path), stages[i].stage, shaderFormat);
+    // Pool uniforms in slot 0, grid uniforms in slot 1.
+    *stages[i].pipeline = CreateComputePipelineFromFile(
+        device, shaderFormat, path, stages[i].entrypoint,
+        numReadWriteStorageBuffers, 2, stages[i].threadCount);
+    if (*stages[i].pipeline == NULL) {
+      NeighborGrid_Destroy(grid, device);
+      return false;
+    }
+  }
+
+  // Buffer sizes and the shader's indices are 32-bit.
+  const Uint64 cellWords = (Uint64)(sparse ? 3 : 2) * u->numCells;
+  const Uint64 slotWords =
+      (Uint64)(GRID_PLANE_COUNT + u->maxNeighbors) * capacity;
+  const Uint64 scanWords = 2 * ((Uint64)u->numScanBlocks + 1);
+  const Uint64 gridSize =
+      sizeof(Uint32) * (cellWords + slotWords + scanWords);
+  // Fewer planes than the grid buffer, so it fits whenever that does.
+  const Uint64 sortedSize =
+      sizeof(float) * (Uint64)SORTED_PLANE_COUNT * capacity;
+  if (gridSize > SDL_MAX_UINT32) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "A neighbour grid of %llu bytes is over the 4 GiB limit",
+                 (unsigned long long)gridSize);
+    NeighborGrid_Destroy(grid, device);
+    return false;
+  }
+  SDL_GPUBufferCreateInfo createInfo = {
+      .usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ |
+               SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE,
+      .size = (Uint32)gridSize};
+  grid->gridBuffer = SDL_CreateGPUBuffer(device, &createInfo);
+  createInfo.size = (Uint32)sortedSize;
+  grid->sortedBuffer = SDL_CreateGPUBuffer(device, &createInfo);
+  if (grid->gridBuffer == NULL || grid->sortedBuffer == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't create neighbour grid buffers: %s", SDL_GetError());
+    NeighborGrid_Destroy(grid, device);
+    return false;
+  }
+  return true;
+}
+
+void NeighborGrid_Destroy(NeighborGrid *grid, SDL_GPUDevice *device) {
+  if (grid == NULL || device == NULL) {
+    return;
+  }
+  SDL_GPUComputePipeline **pipelines[] = {
+      &grid->gatePipeline,       &grid->clearPipeline,
+      &grid->countPipeline,      &grid->scanReducePipeline,
+      &grid->scanBlocksPipeline, &grid->scanDownPipeline,
+      &grid->scatterPipeline,    &grid->listPipeline};
+  for (size_t i = 0; i < SDL_arraysize(pipelines); i++) {
+    if (*pipelines[i] != NULL) {
+      SDL_ReleaseGPUComputePipeline(device, *pipelines[i]);
+      *pipelines[i] = NULL;
+    }
+  }
+  SDL_GPUBuffer **buffers[] = {&grid->gridBuffer, &grid->sortedBuffer};
+  for (size_t i = 0; i < SDL_arraysize(buffers); i++) {
+    if (*buffers[i] != NULL) {
+      SDL_ReleaseGPUBuffer(device, *buffers[i]);
+      *buffers[i] = NULL;
+    }
+  }
+}
+
+void NeighborGrid_FillBindings(const NeighborGrid *grid,
+                               SDL_GPUStorageBufferReadWriteBinding *bindings) {
+  bindings[SIM_BINDING_GRID] = (SDL_GPUStorageBufferReadWriteBinding){
+      .buffer = grid->gridBuffer, .cycle = false};
+  bindings[SIM_BINDING_GRID_SORTED] = (SDL_GPUStorageBufferReadWriteBinding){
+      .buffer = grid->sortedBuffer, .cycle = false};
+}
+
+void NeighborGrid_PushUniforms(const NeighborGrid *grid,
+                               SDL_GPUCommandBuffer *cmdBuf) {
+  SDL_PushGPUComputeUniformData(cmdBuf, 1, &grid->uniforms,
+                                sizeof(grid->uniforms));
+}
+
+// Each grid stage gets its own pass so it sees the previous one's writes.
+static SDL_GPUComputePass *
+BeginGridPass(SDL_GPUCommandBuffer *cmdBuf,
+              const SDL_GPUStorageBufferReadWriteBinding *bindings,
+              Uint32 numBindings, SDL_GPUComputePipeline *pipeline) {
+  SDL_GPUComputePass *pass =
+      SDL_BeginGPUComputePass(cmdBuf, NULL, 0, bindings, numBindings);
+  if (pass == NULL) {
+    SDL_Log("SDL_BeginGPUComputePass (grid) failed: %s", SDL_GetError());
+    return NULL;
+  }
+  SDL_BindGPUComputePipeline(pass, pipeline);
+  return pass;
+}
+
+bool NeighborGrid_Build(const NeighborGrid *grid, SDL_GPUCommandBuffer *cmdBuf,
+                        const SDL_GPUStorageBufferReadWriteBinding *bindings,
+                        SDL_GPUBuffer *indirectArgs) {
+  // The gate and the block scan write dispatches, so they also get the
+  // indirect buffer.
+  SDL_GPUStorageBufferReadWriteBinding argsBindings[SIM_BINDING_COUNT + 1];
+  SDL_memcpy(argsBindings, bindings, sizeof(*bindings) * SIM_BINDING_COUNT);
+  argsBindings[SIM_BINDING_INDIRECT_ARGS] =
+      (SDL_GPUStorageBufferReadWriteBinding){.buffer = indirectArgs,
+                                             .cycle = false};
+
+  // The gate decides whether this step rebuilds and writes the dispatches
+  // below; it and the block scan run as one workgroup. Clear runs over
+  // cells, the other scan passes over scan blocks, the rest over the live
+  // list.
+  const struct {
+    SDL_GPUComputePipeline *pipeline;
+    // False for the single-workgroup stages.
+    bool indirect;
+    Uint32 argsOffset;
+  } stages[] = {
+      {grid->gatePipeline, false, 0},
+      {grid->clearPipeline, true, POOL_GRID_CLEAR_ARGS_OFFSET},
+      {grid->countPipeline, true, POOL_GRID_PARTICLE_ARGS_OFFSET},
+      {grid->scanReducePipeline, true, POOL_GRID_SCAN_ARGS_OFFSET},
+      {grid->scanBlocksPipeline, false, 0},
+      {grid->scanDownPipeline, true, POOL_GRID_SCAN_ARGS_OFFSET},
+      {grid->scatterPipeline, true, POOL_GRID_PARTICLE_ARGS_OFFSET},
+      {grid->listPipeline, true, POOL_GRID_PARTICLE_ARGS_OFFSET},
+  };
+  for (size_t i = 0; i < SDL_arraysize(stages); i++) {
+    if (stages[i].pipeline == NULL) {
+      continue;
+    }
+    SDL_GPUComputePass *pass =
+        stages[i].indirect
+            ? BeginGridPass(cmdBuf, bindings, SIM_BINDING_COUNT,
+                            stages[i].pipeline)
+            : BeginGridPass(cmdBuf, argsBindings, SDL_arraysize(argsBindings),
+                            stages[i].pipeline);
+    if (pass == NULL) {
+      return false;
+    }
+    if (stages[i].indirect) {
+      SDL_DispatchGPUComputeIndirect(pass, indirectArgs, stages[i].argsOffset);
+    } else {
+      SDL_DispatchGPUCompute(pass, 1, 1, 1);
+    }
+    SDL_EndGPUComputePass(pass);
+  }
+  return true;
+}
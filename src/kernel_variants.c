@@ -0,0 +1,177 @@
+#include "kernel_variants.h"
+
+#include "shader_utils.h"
+
+const Uint32 kKernelGroupSizes[KERNEL_NUM_GROUP_SIZES] = {64, 128, 256};
+
+static const char *const kSmoothingNames[SMOOTHING_KERNEL_COUNT] = {
+    "poly6", "spiky", "wendland"};
+static const char *const kBoundaryNames[BOUNDARY_MODE_COUNT] = {
+    "reflect", "periodic", "open"};
+static const char *const kPrecisionNames[] = {"fp32", "fp16", "auto"};
+static const char *const kNeighborNames[] = {"global", "tiled", "list",
+                                             "auto"};
+static const char *const kGridLayoutNames[] = {"dense", "sparse"};
+
+KernelConfig KernelConfig_Default(void) {
+  return (KernelConfig){.smoothing = SMOOTHING_KERNEL_SPIKY,
+                        .boundary = BOUNDARY_REFLECT,
+                        .precision = KERNEL_PRECISION_FP32,
+                        .groupSize = 0,
+                        .neighbors = NEIGHBOR_MODE_AUTO,
+                        .gridLayout = GRID_LAYOUT_DENSE,
+                        .neighborSkin = 0.25f};
+}
+
+static bool ParseName(const char *name, const char *const *names, int count,
+                      int *out) {
+  for (int i = 0; i < count; i++) {
+    if (SDL_strcmp(name, names[i]) == 0) {
+      *out = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool KernelVariants_ParseSmoothing(const char *name, SmoothingKernel *out) {
+  int value = 0;
+  if (!ParseName(name, kSmoothingNames, SMOOTHING_KERNEL_COUNT, &value)) {
+    return false;
+  }
+  *out = (SmoothingKernel)value;
+  return true;
+}
+
+bool KernelVariants_ParseBoundary(const char *name, BoundaryMode *out) {
+  int value = 0;
+  if (!ParseName(name, kBoundaryNames, BOUNDARY_MODE_COUNT, &value)) {
+    return false;
+  }
+  *out = (BoundaryMode)value;
+  return true;
+}
+
+bool KernelVariants_ParsePrecision(const char *name, KernelPrecision *out) {
+  int value = 0;
+  if (!ParseName(name, kPrecisionNames, (int)SDL_arraysize(kPrecisionNames),
+                 &value)) {
+    return false;
+  }
+  *out = (KernelPrecision)value;
+  return true;
+}
+
+bool KernelVariants_ParseNeighbors(const char *name, NeighborMode *out) {
+  int value = 0;
+  if (!ParseName(name, kNeighborNames, (int)SDL_arraysize(kNeighborNames),
+                 &value)) {
+    return false;
+  }
+  *out = (NeighborMode)value;
+  return true;
+}
+
+bool KernelVariants_ParseGridLayout(const char *name, GridLayout *out) {
+  int value = 0;
+  if (!ParseName(name, kGridLayoutNames,
+                 (int)SDL_arraysize(kGridLayoutNames), &value)) {
+    return false;
+  }
+  *out = (GridLayout)value;
+  return true;
+}
+
+const char *KernelVariants_NeighborsName(NeighborMode neighbors) {
+  return kNeighborNames[neighbors];
+}
+
+void KernelVariants_Describe(char *out, size_t outSize,
+                             SmoothingKernel smoothing, BoundaryMode boundary,
+                             GridLayout layout, KernelPrecision precision,
+                             Uint32 groupSize) {
+  SDL_snprintf(out, outSize, "%s-%s-%s-%s-%u", kSmoothingNames[smoothing],
+               kBoundaryNames[boundary], kGridLayoutNames[layout],
+               kPrecisionNames[precision], groupSize);
+}
+
+// Matches the names CMakeLists.txt builds: assets/variants/particles.<stage>.<variant>.
+static void BuildVariantPath(char *out, size_t outSize, const char *stage,
+                             const char *variantName,
+                             SDL_GPUShaderFormat shaderFormat) {
+  SDL_snprintf(out, outSize, "assets/variants/particles.%s.%s.%s", stage,
+               variantName,
+               shaderFormat == SDL_GPU_SHADERFORMAT_MSL ? "msl" : "spv");
+}
+
+bool KernelVariant_Load(KernelVariant *variant, SDL_GPUDevice *device,
+                        SDL_GPUShaderFormat shaderFormat,
+                        SmoothingKernel smoothing, BoundaryMode boundary,
+                        GridLayout layout, KernelPrecision precision,
+                        Uint32 groupSize, NeighborMode neighbors,
+                        Uint32 numReadWriteStorageBuffers,
+                        Uint32 numUniformBuffers) {
+  SDL_zerop(variant);
+  variant->smoothing = smoothing;
+  variant->boundary = boundary;
+  variant->precision = precision;
+  variant->groupSize = groupSize;
+  variant->neighbors = neighbors;
+  variant->layout = layout;
+
+  char name[64];
+  KernelVariants_Describe(name, sizeof(name), smoothing, boundary, layout,
+                          precision, groupSize);
+
+  // Density and force stage names per neighbour mode.
+  static const char *const kInteractionStages[][4] = {
+      [NEIGHBOR_MODE_GLOBAL] = {"density", "densityCS", "force", "forceCS"},
+      [NEIGHBOR_MODE_TILED] = {"densitytiled", "densityTiledCS", "forcetiled",
+                               "forceTiledCS"},
+      [NEIGHBOR_MODE_LIST] = {"densitylist", "densityListCS", "forcelist",
+                              "forceListCS"},
+  };
+  const char *const *interaction = kInteractionStages[neighbors];
+
+  struct {
+    const char *stage;
+    const char *entrypoint;
+    SDL_GPUComputePipeline **pipeline;
+  } stages[] = {
+      {interaction[0], interaction[1], &variant->density},
+      {interaction[2], interaction[3], &variant->force},
+      {"integrate", "mainCS", &variant->integrate},
+  };
+  for (size_t i = 0; i < SDL_arraysize(stages); i++) {
+    char path[256];
+    BuildVariantPath(path, sizeof(path), stages[i].stage, name, shaderFormat);
+    if (!SDL_GetPathInfo(path, NULL)) {
+      SDL_SetError("%s is not in this build (see WAVEGUIDE_ALL_VARIANTS)",
+                   path);
+      KernelVariant_Destroy(variant, device);
+      return false;
+    }
+    *stages[i].pipeline = CreateComputePipelineFromFile(
+        device, shaderFormat, path, stages[i].entrypoint,
+        numReadWriteStorageBuffers, numUniformBuffers, groupSize);
+    if (*stages[i].pipeline == NULL) {
+      KernelVariant_Destroy(variant, device);
+      return false;
+    }
+  }
+  return true;
+}
+
+void KernelVariant_Destroy(KernelVariant *variant, SDL_GPUDevice *device) {
+  if (variant == NULL || device == NULL) {
+    return;
+  }
+  SDL_GPUComputePipeline **pipelines[] = {&variant->density, &variant->force,
+                                          &variant->integrate};
+  for (size_t i = 0; i < SDL_arraysize(pipelines); i++) {
+    if (*pipelines[i] != NULL) {
+      SDL_ReleaseGPUComputePipeline(device, *pipelines[i]);
+      *pipelines[i] = NULL;
+    }
+  }
+}
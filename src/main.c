@@ -10,8 +10,12 @@
 #include <stdlib.h>
 #include <time.h>
 
+#include "capture.h"
+#include "publish.h"
 #include "render.h"
-#include "shader_utils.h"
+#include "sim.h"
+#include "soft_present.h"
+#include "sweep.h"
 
 // We'll have some things we want to keep track of as we move
 // through the lifecycle functions. Globals would be fine for
@@ -24,16 +28,263 @@ typedef struct AppContext {
   SDL_Window *window;
   SDL_GPUDevice *device;
   RenderState render;
-  SDL_GPUComputePipeline *computePipeline;
-  SDL_GPUBuffer *xCurrBuffer;
-  SDL_GPUBuffer *yCurrBuffer;
-  SDL_GPUBuffer *xPrevBuffer;
-  SDL_GPUBuffer *yPrevBuffer;
-  SDL_GPUBuffer *massBuffer;
-  SDL_GPUBuffer *densityBuffer;
-  int numParticles;
+  Sim sim;
+  bool capturing;
+  Capture capture;
+  bool publishing;
+  Publisher publisher;
+  // False when presenting through SDL_Renderer instead.
+  bool windowClaimed;
+  bool softPresenting;
+  SoftPresenter softPresenter;
 } AppContext;
 
+// Command-line switches. Everything defaults to the interactive window.
+typedef struct AppOptions {
+  bool capture;
+  CaptureSettings captureSettings;
+  // Stream particle state to shared memory for external tools.
+  bool publish;
+  PublishSettings publishSettings;
+  // Read one frame from another process's --publish ring and exit.
+  const char *publishReadName;
+  // Draw the window on the CPU (see soft_present.h) instead of through a
+  // GPU swapchain.
+  bool softPresent;
+  int softPresentThreads;
+  // Headless batch run: sweep file in, per-scene results out.
+  const char *sweepPath;
+  const char *sweepOutPath;
+  SweepRenderSettings sweepRender;
+  KernelConfig kernels;
+  // Split and merge particles in the interactive scene.
+  bool adaptive;
+  // Print the usage and exit.
+  bool help;
+} AppOptions;
+
+static void PrintUsage(const char *program) {
+  printf(
+      "Usage: %s [options]\n"
+      "\n"
+      "  --capture PATH               record frames to a file or |command\n"
+      "  --capture-format raw|y4m     frame format (default from PATH)\n"
+      "  --capture-size WxH           capture resolution\n"
+      "  --capture-fps N              frame rate written to y4m headers\n"
+      "  --capture-frames N           stop after N frames\n"
+      "  --publish NAME               stream particles to shared memory\n"
+      "  --publish-every N            publish every Nth step\n"
+      "  --publish-read NAME          check a running --publish ring: read\n"
+      "                               its newest frame and exit\n"
+      "  --soft-present               draw the window on the CPU instead of\n"
+      "                               through a swapchain; the simulation\n"
+      "                               still runs on an SDL GPU device\n"
+      "  --soft-present-threads N     CPU drawing threads (0 = all cores)\n"
+      "  --sweep FILE                 headless parameter sweep (sweep.h)\n"
+      "  --sweep-out FILE             sweep results CSV (default stdout)\n"
+      "  --sweep-render DIR           write sweep frames as PPM\n"
+      "  --sweep-render-size WxH      sweep frame size\n"
+      "  --sweep-render-every N       also render every N frames\n"
+      "  --sweep-render-threads N     sweep rendering threads\n"
+      "  --kernel poly6|spiky|wendland\n"
+      "  --boundary reflect|periodic|open\n"
+      "  --precision fp32|fp16|auto\n"
+      "  --workgroup 64|128|256|auto\n"
+      "  --neighbors global|tiled|list|auto\n"
+      "  --neighbor-skin F            list skin, fraction of the radius\n"
+      "  --grid dense|sparse          neighbour grid layout\n"
+      "  --adaptive                   split and merge particles\n"
+      "  --help                       show this text\n",
+      program);
+}
+
+static bool EndsWith(const char *str, const char *suffix) {
+  size_t strLen = SDL_strlen(str);
+  size_t suffixLen = SDL_strlen(suffix);
+  return strLen >= suffixLen &&
+         SDL_strcmp(str + strLen - suffixLen, suffix) == 0;
+}
+
+static bool ParseArgs(int argc, char **argv, AppOptions *options) {
+  SDL_zerop(options);
+  options->kernels = KernelConfig_Default();
+  options->sweepRender.width = 512;
+  options->sweepRender.height = 512;
+  bool formatGiven = false;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if (SDL_strcmp(arg, "--capture") == 0 && value != NULL) {
+      options->capture = true;
+      options->captureSettings.path = value;
+      i++;
+    } else if (SDL_strcmp(arg, "--capture-format") == 0 && value != NULL) {
+      if (!Capture_ParseFormat(value, &options->captureSettings.format)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unknown capture format '%s' (raw or y4m)", value);
+        return false;
+      }
+      formatGiven = true;
+      i++;
+    } else if (SDL_strcmp(arg, "--capture-size") == 0 && value != NULL) {
+      if (SDL_sscanf(value, "%ux%u", &options->captureSettings.width,
+                     &options->captureSettings.height) != 2) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Capture size must look like 1920x1080, got '%s'", value);
+        return false;
+      }
+      i++;
+    } else if (SDL_strcmp(arg, "--capture-fps") == 0 && value != NULL) {
+      options->captureSettings.fps = (Uint32)SDL_atoi(value);
+      i++;
+    } else if (SDL_strcmp(arg, "--capture-frames") == 0 && value != NULL) {
+      options->captureSettings.maxFrames = (Uint64)SDL_strtoull(value, NULL, 10);
+      i++;
+    } else if (SDL_strcmp(arg, "--publish") == 0 && value != NULL) {
+      options->publish = true;
+      options->publishSettings.name = value;
+      i++;
+    } else if (SDL_strcmp(arg, "--publish-read") == 0 && value != NULL) {
+      options->publishReadName = value;
+      i++;
+    } else if (SDL_strcmp(arg, "--publish-every") == 0 && value != NULL) {
+      options->publishSettings.every = (Uint32)SDL_atoi(value);
+      i++;
+    } else if (SDL_strcmp(arg, "--soft-present") == 0) {
+      options->softPresent = true;
+    } else if (SDL_strcmp(arg, "--soft-present-threads") == 0 &&
+               value != NULL) {
+      options->softPresentThreads = SDL_atoi(value);
+      i++;
+    } else if (SDL_strcmp(arg, "--sweep") == 0 && value != NULL) {
+      options->sweepPath = value;
+      i++;
+    } else if (SDL_strcmp(arg, "--sweep-out") == 0 && value != NULL) {
+      options->sweepOutPath = value;
+      i++;
+    } else if (SDL_strcmp(arg, "--sweep-render") == 0 && value != NULL) {
+      options->sweepRender.directory = value;
+      i++;
+    } else if (SDL_strcmp(arg, "--sweep-render-size") == 0 && value != NULL) {
+      if (SDL_sscanf(value, "%dx%d", &options->sweepRender.width,
+                     &options->sweepRender.height) != 2) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Render size must look like 512x512, got '%s'", value);
+        return false;
+      }
+      i++;
+    } else if (SDL_strcmp(arg, "--sweep-render-every") == 0 && value != NULL) {
+      options->sweepRender.every = (Uint32)SDL_atoi(value);
+      i++;
+    } else if (SDL_strcmp(arg, "--sweep-render-threads") == 0 &&
+               value != NULL) {
+      options->sweepRender.threads = SDL_atoi(value);
+      i++;
+    } else if (SDL_strcmp(arg, "--kernel") == 0 && value != NULL) {
+      if (!KernelVariants_ParseSmoothing(value, &options->kernels.smoothing)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unknown kernel '%s' (poly6, spiky or wendland)", value);
+        return false;
+      }
+      i++;
+    } else if (SDL_strcmp(arg, "--boundary") == 0 && value != NULL) {
+      if (!KernelVariants_ParseBoundary(value, &options->kernels.boundary)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unknown boundary '%s' (reflect, periodic or open)",
+                     value);
+        return false;
+      }
+      i++;
+    } else if (SDL_strcmp(arg, "--precision") == 0 && value != NULL) {
+      // fp32 unless told otherwise; fp16 and auto trust the device with half
+      // precision.
+      if (!KernelVariants_ParsePrecision(value, &options->kernels.precision)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unknown precision '%s' (fp32, fp16 or auto)", value);
+        return false;
+      }
+      i++;
+    } else if (SDL_strcmp(arg, "--workgroup") == 0 && value != NULL) {
+      // "auto" (or 0) leaves it to the startup benchmark.
+      options->kernels.groupSize =
+          SDL_strcmp(value, "auto") == 0 ? 0 : (Uint32)SDL_atoi(value);
+      i++;
+    } else if (SDL_strcmp(arg, "--neighbors") == 0 && value != NULL) {
+      if (!KernelVariants_ParseNeighbors(value, &options->kernels.neighbors)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unknown neighbour mode '%s' "
+                     "(global, tiled, list or auto)",
+                     value);
+        return false;
+      }
+      i++;
+    } else if (SDL_strcmp(arg, "--neighbor-skin") == 0 && value != NULL) {
+      options->kernels.neighborSkin = (float)SDL_atof(value);
+      i++;
+    } else if (SDL_strcmp(arg, "--grid") == 0 && value != NULL) {
+      if (!KernelVariants_ParseGridLayout(value,
+                                          &options->kernels.gridLayout)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unknown grid layout '%s' (dense or sparse)", value);
+        return false;
+      }
+      i++;
+    } else if (SDL_strcmp(arg, "--adaptive") == 0) {
+      options->adaptive = true;
+    } else if (SDL_strcmp(arg, "--help") == 0) {
+      options->help = true;
+    } else {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Unknown or incomplete argument '%s'", arg);
+      return false;
+    }
+  }
+  if (options->capture && options->softPresent) {
+    // Capture renders through the GPU graphics pipeline.
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "--capture and --soft-present can't be combined");
+    return false;
+  }
+  if (options->capture && !formatGiven) {
+    options->captureSettings.format =
+        EndsWith(options->captureSettings.path, ".y4m") ? CAPTURE_FORMAT_Y4M
+                                                        : CAPTURE_FORMAT_RAW;
+  }
+  return true;
+}
+
+// Next up, let's create a GPU device. You'll need to tell the
+// API up front what shader languages you plan on supporting.
+// SDL looks through its list of drivers in "a reasonable
+// order" to pick which one to use. Fun surprise here: on
+// Windows, it's going to prefer Vulkan over Direct3D 12 if
+// it's available. Here, we're enabling Vulkan (SPIRV),
+// Direct3D 12 (DXIL), and Metal (MSL).
+//
+// Reports which of our compiled shader flavours the device wants.
+static SDL_GPUDevice *CreateDevice(SDL_GPUShaderFormat *outShaderFormat) {
+  SDL_GPUShaderFormat shaderFormats = SDL_GPU_SHADERFORMAT_SPIRV |
+                                      SDL_GPU_SHADERFORMAT_DXIL |
+                                      SDL_GPU_SHADERFORMAT_MSL;
+
+  SDL_GPUDevice *device = SDL_CreateGPUDevice(shaderFormats, false, NULL);
+  if (device == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't not create GPU device: %s", SDL_GetError());
+    return NULL;
+  }
+
+  // Just so we know what we're working with, log the driver that
+  // SDL picked for us.
+  const char *driverName = SDL_GetGPUDeviceDriver(device);
+  SDL_Log("Using %s GPU implementation.", driverName ? driverName : "unknown");
+  bool useMSLShaders =
+      (driverName != NULL && SDL_strcmp(driverName, "metal") == 0);
+  *outShaderFormat =
+      useMSLShaders ? SDL_GPU_SHADERFORMAT_MSL : SDL_GPU_SHADERFORMAT_SPIRV;
+  return device;
+}
+
 // SDL_AppInit is the first function that will be called. This is
 // where you initialize SDL, load resources that your game will
 // need from the start, etc.
@@ -43,8 +294,15 @@ SDL_AppResult SDL_AppInit(
 
     // Normal main argc & argv
     int argc, char **argv) {
-  (void)argc;
-  (void)argv;
+  AppOptions options;
+  if (!ParseArgs(argc, argv, &options)) {
+    return SDL_APP_FAILURE;
+  }
+  if (options.help) {
+    PrintUsage(argv[0]);
+    return SDL_APP_SUCCESS;
+  }
+
   // This isn't strictly necessary, but if you provide a little
   // bit of metadata here SDL will use it in things like the
   // About window on macOS.
@@ -60,6 +318,27 @@ SDL_AppResult SDL_AppInit(
     return SDL_APP_FAILURE;
   }
 
+  // Reading a ring needs neither a window nor a GPU.
+  if (options.publishReadName != NULL) {
+    return PublishReader_Check(options.publishReadName) ? SDL_APP_SUCCESS
+                                                        : SDL_APP_FAILURE;
+  }
+
+  // Sweeps never open a window: build the batch, run it to completion and
+  // exit.
+  if (options.sweepPath != NULL) {
+    SDL_GPUShaderFormat shaderFormat = 0;
+    SDL_GPUDevice *device = CreateDevice(&shaderFormat);
+    if (device == NULL) {
+      return SDL_APP_FAILURE;
+    }
+    bool ok = Sweep_Run(device, shaderFormat, &options.kernels,
+                        options.sweepPath, options.sweepOutPath,
+                        &options.sweepRender);
+    SDL_DestroyGPUDevice(device);
+    return ok ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+  }
+
   // Create a window. I'm creating a high pixel density window
   // because without that, I was getting blurry text on macOS.
   // (text comes in a later post, promise.)
@@ -75,88 +354,32 @@ SDL_AppResult SDL_AppInit(
     return SDL_APP_FAILURE;
   }
 
-  // Next up, let's create a GPU device. You'll need to tell the
-  // API up front what shader languages you plan on supporting.
-  // SDL looks through its list of drivers in "a reasonable
-  // order" to pick which one to use. Fun surprise here: on
-  // Windows, it's going to prefer Vulkan over Direct3D 12 if
-  // it's available. Here, we're enabling Vulkan (SPIRV),
-  // Direct3D 12 (DXIL), and Metal (MSL).
-  SDL_GPUShaderFormat shaderFormats = SDL_GPU_SHADERFORMAT_SPIRV |
-                                      SDL_GPU_SHADERFORMAT_DXIL |
-                                      SDL_GPU_SHADERFORMAT_MSL;
-
-  SDL_GPUDevice *device = SDL_CreateGPUDevice(shaderFormats, false, NULL);
+  SDL_GPUShaderFormat shaderFormat = 0;
+  SDL_GPUDevice *device = CreateDevice(&shaderFormat);
   if (device == NULL) {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                 "Couldn't not create GPU device: %s", SDL_GetError());
     return SDL_APP_FAILURE;
   }
 
-  // Just so we know what we're working with, log the driver that
-  // SDL picked for us.
-  const char *driverName = SDL_GetGPUDeviceDriver(device);
-  SDL_Log("Using %s GPU implementation.", driverName ? driverName : "unknown");
-  bool useMSLShaders =
-      (driverName != NULL && SDL_strcmp(driverName, "metal") == 0);
-
-  // Then bind the window and GPU device together
-  if (!SDL_ClaimWindowForGPUDevice(device, window)) {
-    SDL_Log("SDL_ClaimWindowForGPUDevice failed: %s", SDL_GetError());
-    return SDL_APP_FAILURE;
-  }
-
-  const char *vertexShaderPath =
-      useMSLShaders ? "assets/particles.vert.msl" : "assets/particles.vert.spv";
-  const char *fragmentShaderPath =
-      useMSLShaders ? "assets/particles.frag.msl" : "assets/particles.frag.spv";
-  const char *computeShaderPath =
-      useMSLShaders ? "assets/particles.comp.msl" : "assets/particles.comp.spv";
-  SDL_GPUShaderFormat shaderFormat =
-      useMSLShaders ? SDL_GPU_SHADERFORMAT_MSL : SDL_GPU_SHADERFORMAT_SPIRV;
-
-  // Load compute shader code and create compute pipeline
-  Uint8 *compCode = NULL;
-  size_t compSize = 0;
-  if (!LoadShaderFile(computeShaderPath, &compCode, &compSize)) {
-    return SDL_APP_FAILURE;
-  }
-
-  SDL_GPUComputePipelineCreateInfo computeCreateInfo = {
-      .code_size = compSize,
-      .code = compCode,
-      .entrypoint = "mainCS",
-      .format = shaderFormat,
-      .num_samplers = 0,
-      .num_readonly_storage_textures = 0,
-      .num_readonly_storage_buffers = 0,
-      .num_readwrite_storage_textures = 0,
-  // Storage buffers bound at slots 0-5.
-  .num_readwrite_storage_buffers = 6,
-  // No uniforms.
-  .num_uniform_buffers = 0,
-      .threadcount_x = 64,
-      .threadcount_y = 1,
-      .threadcount_z = 1,
-      .props = 0};
-
-  SDL_GPUComputePipeline *computePipeline =
-      SDL_CreateGPUComputePipeline(device, &computeCreateInfo);
-  if (computePipeline == NULL) {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                 "Couldn't create compute pipeline: %s", SDL_GetError());
-    SDL_free(compCode);
-    return SDL_APP_FAILURE;
-  }
+  // Then bind the window and GPU device together, unless the window is
+  // drawn on the CPU and the device only simulates.
+  RenderState render = {0};
+  if (!options.softPresent) {
+    if (!SDL_ClaimWindowForGPUDevice(device, window)) {
+      SDL_Log("SDL_ClaimWindowForGPUDevice failed: %s", SDL_GetError());
+      return SDL_APP_FAILURE;
+    }
 
-  // Free the shader code as it's no longer needed after creating the shaders
-  SDL_free(compCode);
+    const bool useMSLShaders = shaderFormat == SDL_GPU_SHADERFORMAT_MSL;
+    const char *vertexShaderPath = useMSLShaders ? "assets/particles.vert.msl"
+                                                 : "assets/particles.vert.spv";
+    const char *fragmentShaderPath = useMSLShaders
+                                         ? "assets/particles.frag.msl"
+                                         : "assets/particles.frag.spv";
 
-  RenderState render = {0};
-  if (!Render_Init(&render, device, shaderFormat, vertexShaderPath,
-                   fragmentShaderPath)) {
-    SDL_ReleaseGPUComputePipeline(device, computePipeline);
-    return SDL_APP_FAILURE;
+    if (!Render_Init(&render, device, shaderFormat, vertexShaderPath,
+                     fragmentShaderPath)) {
+      return SDL_APP_FAILURE;
+    }
   }
 
   // Create buffer for particle data based on the Slang shader
@@ -172,8 +395,10 @@ SDL_AppResult SDL_AppInit(
   const float halfWidth = drawableWidth * 0.5f;
   const float halfHeight = drawableHeight * 0.5f;
 
-  const int numParticles =
-      1024; // multiple of 64 to match compute threadgroup dispatch
+  // Buffers are sized to the pool capacity up front; emitters fill free
+  // slots on the GPU, so nothing is reallocated while running.
+  const Uint32 particleCapacity = 16384;
+  const int numParticles = 1024;
 
   size_t floatBufferSize = sizeof(float) * (size_t)numParticles;
   float *xCurr = (float *)SDL_malloc(floatBufferSize);
@@ -181,10 +406,10 @@ SDL_AppResult SDL_AppInit(
   float *xPrev = (float *)SDL_malloc(floatBufferSize);
   float *yPrev = (float *)SDL_malloc(floatBufferSize);
   float *mass = (float *)SDL_malloc(floatBufferSize);
-  float *density = (float *)SDL_malloc(floatBufferSize);
+  Uint32 *sceneId = (Uint32 *)SDL_calloc((size_t)numParticles, sizeof(Uint32));
 
   if (xCurr == NULL || yCurr == NULL || xPrev == NULL || yPrev == NULL ||
-      mass == NULL || density == NULL) {
+      mass == NULL || sceneId == NULL) {
     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                  "Couldn't allocate particle data buffers");
     SDL_free(xCurr);
@@ -192,9 +417,8 @@ SDL_AppResult SDL_AppInit(
     SDL_free(xPrev);
     SDL_free(yPrev);
     SDL_free(mass);
-    SDL_free(density);
+    SDL_free(sceneId);
     Render_Destroy(&render, device);
-    SDL_ReleaseGPUComputePipeline(device, computePipeline);
     return SDL_APP_FAILURE;
   }
 
@@ -217,223 +441,66 @@ SDL_AppResult SDL_AppInit(
     xPrev[i] = posX;
     yPrev[i] = posY;
     mass[i] = 1.0f;
-    density[i] = 0.0f;
-  }
-
-  SDL_GPUBufferCreateInfo bufferCreateInfo = {
-      .usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ |
-               SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ |
-               SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE,
-      .size = floatBufferSize};
-
-  SDL_GPUBuffer *xCurrBuffer = SDL_CreateGPUBuffer(device, &bufferCreateInfo);
-  SDL_GPUBuffer *yCurrBuffer = SDL_CreateGPUBuffer(device, &bufferCreateInfo);
-  SDL_GPUBuffer *xPrevBuffer = SDL_CreateGPUBuffer(device, &bufferCreateInfo);
-  SDL_GPUBuffer *yPrevBuffer = SDL_CreateGPUBuffer(device, &bufferCreateInfo);
-  SDL_GPUBuffer *massBuffer = SDL_CreateGPUBuffer(device, &bufferCreateInfo);
-  SDL_GPUBuffer *densityBuffer = SDL_CreateGPUBuffer(device, &bufferCreateInfo);
-
-  if (xCurrBuffer == NULL || yCurrBuffer == NULL || xPrevBuffer == NULL ||
-      yPrevBuffer == NULL || massBuffer == NULL || densityBuffer == NULL) {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                 "Couldn't create particle buffers: %s", SDL_GetError());
-    SDL_ReleaseGPUBuffer(device, xCurrBuffer);
-    SDL_ReleaseGPUBuffer(device, yCurrBuffer);
-    SDL_ReleaseGPUBuffer(device, xPrevBuffer);
-    SDL_ReleaseGPUBuffer(device, yPrevBuffer);
-    SDL_ReleaseGPUBuffer(device, massBuffer);
-    SDL_ReleaseGPUBuffer(device, densityBuffer);
-    SDL_free(xCurr);
-    SDL_free(yCurr);
-    SDL_free(xPrev);
-    SDL_free(yPrev);
-    SDL_free(mass);
-    SDL_free(density);
-    Render_Destroy(&render, device);
-    SDL_ReleaseGPUComputePipeline(device, computePipeline);
-    return SDL_APP_FAILURE;
-  }
-
-  // Create upload buffers for each attribute.
-  SDL_GPUTransferBuffer *txXCurr = SDL_CreateGPUTransferBuffer(
-      device, &(SDL_GPUTransferBufferCreateInfo){
-                  .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-                  .size = floatBufferSize});
-  SDL_GPUTransferBuffer *txYCurr = SDL_CreateGPUTransferBuffer(
-      device, &(SDL_GPUTransferBufferCreateInfo){
-                  .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-                  .size = floatBufferSize});
-  SDL_GPUTransferBuffer *txXPrev = SDL_CreateGPUTransferBuffer(
-      device, &(SDL_GPUTransferBufferCreateInfo){
-                  .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-                  .size = floatBufferSize});
-  SDL_GPUTransferBuffer *txYPrev = SDL_CreateGPUTransferBuffer(
-      device, &(SDL_GPUTransferBufferCreateInfo){
-                  .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-                  .size = floatBufferSize});
-  SDL_GPUTransferBuffer *txMass = SDL_CreateGPUTransferBuffer(
-      device, &(SDL_GPUTransferBufferCreateInfo){
-                  .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-                  .size = floatBufferSize});
-  SDL_GPUTransferBuffer *txDensity = SDL_CreateGPUTransferBuffer(
-      device, &(SDL_GPUTransferBufferCreateInfo){
-                  .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-                  .size = floatBufferSize});
-
-  if (txXCurr == NULL || txYCurr == NULL || txXPrev == NULL ||
-      txYPrev == NULL || txMass == NULL || txDensity == NULL) {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                 "Couldn't create transfer buffers: %s", SDL_GetError());
-    SDL_ReleaseGPUTransferBuffer(device, txXCurr);
-    SDL_ReleaseGPUTransferBuffer(device, txYCurr);
-    SDL_ReleaseGPUTransferBuffer(device, txXPrev);
-    SDL_ReleaseGPUTransferBuffer(device, txYPrev);
-    SDL_ReleaseGPUTransferBuffer(device, txMass);
-    SDL_ReleaseGPUTransferBuffer(device, txDensity);
-    SDL_ReleaseGPUBuffer(device, xCurrBuffer);
-    SDL_ReleaseGPUBuffer(device, yCurrBuffer);
-    SDL_ReleaseGPUBuffer(device, xPrevBuffer);
-    SDL_ReleaseGPUBuffer(device, yPrevBuffer);
-    SDL_ReleaseGPUBuffer(device, massBuffer);
-    SDL_ReleaseGPUBuffer(device, densityBuffer);
-    SDL_free(xCurr);
-    SDL_free(yCurr);
-    SDL_free(xPrev);
-    SDL_free(yPrev);
-    SDL_free(mass);
-    SDL_free(density);
-    Render_Destroy(&render, device);
-    SDL_ReleaseGPUComputePipeline(device, computePipeline);
-    return SDL_APP_FAILURE;
-  }
-
-  struct {
-    SDL_GPUTransferBuffer *tx;
-    const float *data;
-    SDL_GPUBuffer *gpuBuf;
-  } uploads[] = {
-      {txXCurr, xCurr, xCurrBuffer}, {txYCurr, yCurr, yCurrBuffer},
-      {txXPrev, xPrev, xPrevBuffer}, {txYPrev, yPrev, yPrevBuffer},
-      {txMass, mass, massBuffer},    {txDensity, density, densityBuffer},
-  };
-
-  bool mappingFailed = false;
-  for (size_t i = 0; i < SDL_arraysize(uploads); i++) {
-    void *mapped = SDL_MapGPUTransferBuffer(device, uploads[i].tx, false);
-    if (mapped == NULL) {
-      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                   "Couldn't map transfer buffer: %s", SDL_GetError());
-      mappingFailed = true;
-    } else {
-      SDL_memcpy(mapped, uploads[i].data, floatBufferSize);
-      SDL_UnmapGPUTransferBuffer(device, uploads[i].tx);
-    }
-  }
-
-  if (mappingFailed) {
-    SDL_ReleaseGPUTransferBuffer(device, txXCurr);
-    SDL_ReleaseGPUTransferBuffer(device, txYCurr);
-    SDL_ReleaseGPUTransferBuffer(device, txXPrev);
-    SDL_ReleaseGPUTransferBuffer(device, txYPrev);
-    SDL_ReleaseGPUTransferBuffer(device, txMass);
-    SDL_ReleaseGPUTransferBuffer(device, txDensity);
-    SDL_ReleaseGPUBuffer(device, xCurrBuffer);
-    SDL_ReleaseGPUBuffer(device, yCurrBuffer);
-    SDL_ReleaseGPUBuffer(device, xPrevBuffer);
-    SDL_ReleaseGPUBuffer(device, yPrevBuffer);
-    SDL_ReleaseGPUBuffer(device, massBuffer);
-    SDL_ReleaseGPUBuffer(device, densityBuffer);
-    SDL_free(xCurr);
-    SDL_free(yCurr);
-    SDL_free(xPrev);
-    SDL_free(yPrev);
-    SDL_free(mass);
-    SDL_free(density);
-    Render_Destroy(&render, device);
-    SDL_ReleaseGPUComputePipeline(device, computePipeline);
-    return SDL_APP_FAILURE;
   }
 
-  SDL_GPUCommandBuffer *uploadCmdBuf = SDL_AcquireGPUCommandBuffer(device);
-  if (uploadCmdBuf == NULL) {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                 "Couldn't acquire command buffer for upload: %s",
-                 SDL_GetError());
-    SDL_ReleaseGPUTransferBuffer(device, txXCurr);
-    SDL_ReleaseGPUTransferBuffer(device, txYCurr);
-    SDL_ReleaseGPUTransferBuffer(device, txXPrev);
-    SDL_ReleaseGPUTransferBuffer(device, txYPrev);
-    SDL_ReleaseGPUTransferBuffer(device, txMass);
-    SDL_ReleaseGPUTransferBuffer(device, txDensity);
-    SDL_ReleaseGPUBuffer(device, xCurrBuffer);
-    SDL_ReleaseGPUBuffer(device, yCurrBuffer);
-    SDL_ReleaseGPUBuffer(device, xPrevBuffer);
-    SDL_ReleaseGPUBuffer(device, yPrevBuffer);
-    SDL_ReleaseGPUBuffer(device, massBuffer);
-    SDL_ReleaseGPUBuffer(device, densityBuffer);
-    SDL_free(xCurr);
-    SDL_free(yCurr);
-    SDL_free(xPrev);
-    SDL_free(yPrev);
-    SDL_free(mass);
-    SDL_free(density);
-    Render_Destroy(&render, device);
-    SDL_ReleaseGPUComputePipeline(device, computePipeline);
-    return SDL_APP_FAILURE;
-  }
-
-  SDL_GPUCopyPass *copyPass = SDL_BeginGPUCopyPass(uploadCmdBuf);
-  if (copyPass == NULL) {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't begin copy pass: %s",
-                 SDL_GetError());
-    SDL_SubmitGPUCommandBuffer(uploadCmdBuf);
-    SDL_ReleaseGPUTransferBuffer(device, txXCurr);
-    SDL_ReleaseGPUTransferBuffer(device, txYCurr);
-    SDL_ReleaseGPUTransferBuffer(device, txXPrev);
-    SDL_ReleaseGPUTransferBuffer(device, txYPrev);
-    SDL_ReleaseGPUTransferBuffer(device, txMass);
-    SDL_ReleaseGPUTransferBuffer(device, txDensity);
-    SDL_ReleaseGPUBuffer(device, xCurrBuffer);
-    SDL_ReleaseGPUBuffer(device, yCurrBuffer);
-    SDL_ReleaseGPUBuffer(device, xPrevBuffer);
-    SDL_ReleaseGPUBuffer(device, yPrevBuffer);
-    SDL_ReleaseGPUBuffer(device, massBuffer);
-    SDL_ReleaseGPUBuffer(device, densityBuffer);
-    SDL_free(xCurr);
-    SDL_free(yCurr);
-    SDL_free(xPrev);
-    SDL_free(yPrev);
-    SDL_free(mass);
-    SDL_free(density);
-    Render_Destroy(&render, device);
-    SDL_ReleaseGPUComputePipeline(device, computePipeline);
-    return SDL_APP_FAILURE;
-  }
-
-  for (size_t i = 0; i < SDL_arraysize(uploads); i++) {
-    SDL_GPUTransferBufferLocation src = {.transfer_buffer = uploads[i].tx,
-                                         .offset = 0};
-    SDL_GPUBufferRegion dst = {
-        .buffer = uploads[i].gpuBuf, .offset = 0, .size = floatBufferSize};
-    SDL_UploadToGPUBuffer(copyPass, &src, &dst, false);
-  }
-
-  SDL_EndGPUCopyPass(copyPass);
-  SDL_SubmitGPUCommandBuffer(uploadCmdBuf);
-
-  SDL_ReleaseGPUTransferBuffer(device, txXCurr);
-  SDL_ReleaseGPUTransferBuffer(device, txYCurr);
-  SDL_ReleaseGPUTransferBuffer(device, txXPrev);
-  SDL_ReleaseGPUTransferBuffer(device, txYPrev);
-  SDL_ReleaseGPUTransferBuffer(device, txMass);
-  SDL_ReleaseGPUTransferBuffer(device, txDensity);
+  // The interactive window runs a single scene with no gravity or drag. Rest
+  // density is the starting particles per NDC area (the box is 2x2), so the
+  // pressure force only pushes apart crowding from the fountain. With
+  // --adaptive, particles split down to a quarter mass at the fountain's edge
+  // and merge up to four times the mass where it is crowded and calm.
+  const SceneParams scene = {.gravityX = 0.0f,
+                             .gravityY = 0.0f,
+                             .bounce = 0.98f,
+                             .drag = 0.0f,
+                             .smoothingRadius = 0.08f,
+                             .restDensity = (float)numParticles / 4.0f,
+                             .stiffness = 2e-5f,
+                             .minMass = 0.25f,
+                             .maxMass = options.adaptive ? 4.0f : 0.0f,
+                             .surfaceRatio = 0.75f,
+                             .calmSpeed = 0.002f,
+                             // The window shows exactly the NDC box.
+                             .domainMinX = -1.0f,
+                             .domainMinY = -1.0f,
+                             .domainMaxX = 1.0f,
+                             .domainMaxY = 1.0f};
+  SimInitialState initial = {.xCurr = xCurr,
+                             .yCurr = yCurr,
+                             .xPrev = xPrev,
+                             .yPrev = yPrev,
+                             .mass = mass,
+                             .sceneId = sceneId,
+                             .count = (Uint32)numParticles,
+                             .scenes = &scene,
+                             .numScenes = 1};
+  Sim sim;
+  bool simReady =
+      Sim_Init(&sim, device, shaderFormat, particleCapacity, &initial,
+               &options.kernels);
 
   SDL_free(xCurr);
   SDL_free(yCurr);
   SDL_free(xPrev);
   SDL_free(yPrev);
   SDL_free(mass);
-  SDL_free(density);
+  SDL_free(sceneId);
+
+  if (!simReady) {
+    Render_Destroy(&render, device);
+    return SDL_APP_FAILURE;
+  }
+
+  // A fountain in the lower left draining into the opposite corner, so the
+  // live count actually moves.
+  ParticlePool_AddEmitter(&sim.pool, &(ParticleEmitter){.x = -0.8f,
+                                                        .y = -0.8f,
+                                                        .radius = 0.05f,
+                                                        .velX = 0.004f,
+                                                        .velY = 0.008f,
+                                                        .rate = 4.0f,
+                                                        .scene = 0});
+  ParticlePool_AddSink(&sim.pool,
+                       &(ParticleSink){.x = 0.9f, .y = 0.9f, .radius = 0.15f});
 
   // Last up, let's create our context object and store pointers
   // to our window and GPU device. We stick it in the appState
@@ -442,15 +509,11 @@ SDL_AppResult SDL_AppInit(
   AppContext *context = SDL_calloc(1, sizeof(AppContext));
   if (context == NULL) {
     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't allocate app context");
-    SDL_ReleaseGPUBuffer(device, xCurrBuffer);
-    SDL_ReleaseGPUBuffer(device, yCurrBuffer);
-    SDL_ReleaseGPUBuffer(device, xPrevBuffer);
-    SDL_ReleaseGPUBuffer(device, yPrevBuffer);
-    SDL_ReleaseGPUBuffer(device, massBuffer);
-    SDL_ReleaseGPUBuffer(device, densityBuffer);
-    SDL_ReleaseGPUComputePipeline(device, computePipeline);
+    Sim_Destroy(&sim, device);
     Render_Destroy(&render, device);
-    SDL_ReleaseWindowFromGPUDevice(device, window);
+    if (!options.softPresent) {
+      SDL_ReleaseWindowFromGPUDevice(device, window);
+    }
     SDL_DestroyWindow(window);
     SDL_DestroyGPUDevice(device);
     SDL_Quit();
@@ -458,18 +521,44 @@ SDL_AppResult SDL_AppInit(
   }
 
   context->window = window;
+  context->windowClaimed = !options.softPresent;
   context->device = device;
-  context->computePipeline = computePipeline;
   context->render = render;
-  context->xCurrBuffer = xCurrBuffer;
-  context->yCurrBuffer = yCurrBuffer;
-  context->xPrevBuffer = xPrevBuffer;
-  context->yPrevBuffer = yPrevBuffer;
-  context->massBuffer = massBuffer;
-  context->densityBuffer = densityBuffer;
-  context->numParticles = numParticles;
+  context->sim = sim;
   *appState = context;
 
+  // The capture owns a worker thread that points back at it, so it's set up
+  // in place inside the context. Defaults to the window's pixel size.
+  if (options.capture) {
+    CaptureSettings *settings = &options.captureSettings;
+    if (settings->width == 0 || settings->height == 0) {
+      settings->width = (Uint32)drawableWidth;
+      settings->height = (Uint32)drawableHeight;
+    }
+    if (!Capture_Init(&context->capture, device, settings)) {
+      return SDL_APP_FAILURE;
+    }
+    context->capturing = true;
+  }
+
+  // Same for the publisher's writer thread.
+  if (options.publish) {
+    if (!Publisher_Init(&context->publisher, device, shaderFormat,
+                        &context->sim, &options.publishSettings)) {
+      return SDL_APP_FAILURE;
+    }
+    context->publishing = true;
+  }
+
+  // And the presenter's drawing thread.
+  if (options.softPresent) {
+    if (!SoftPresent_Init(&context->softPresenter, device, window,
+                          &context->sim, options.softPresentThreads)) {
+      return SDL_APP_FAILURE;
+    }
+    context->softPresenting = true;
+  }
+
   // And that's it for initialization.
   return SDL_APP_CONTINUE;
 }
@@ -483,6 +572,25 @@ SDL_AppResult SDL_AppIterate(void *appState) {
   // update your game state, etc. I'll be doing that in later
   // posts.
 
+  // In capture mode the simulation is paced by the download ring: if every
+  // slot is still busy we skip this iteration instead of dropping a frame or
+  // waiting on the GPU.
+  if (context->capturing) {
+    if (Capture_Finished(&context->capture)) {
+      return SDL_APP_SUCCESS;
+    }
+    if (!Capture_Ready(&context->capture)) {
+      SDL_Delay(1);
+      return SDL_APP_CONTINUE;
+    }
+  }
+  // Without a swapchain to wait on, software presenting paces the same way.
+  if (context->softPresenting &&
+      !SoftPresent_Ready(&context->softPresenter)) {
+    SDL_Delay(1);
+    return SDL_APP_CONTINUE;
+  }
+
   // Once you're ready to start drawing, begin by grabbing a
   // command buffer and a reference to the swapchain texture.
   SDL_GPUCommandBuffer *cmdBuf;
@@ -493,43 +601,55 @@ SDL_AppResult SDL_AppIterate(void *appState) {
   }
 
   // GPU compute integration of particle positions.
-  Uint32 groupCountX = (Uint32)((context->numParticles + 63) / 64);
-  SDL_GPUStorageBufferReadWriteBinding rwBindings[] = {
-      {.buffer = context->xCurrBuffer, .cycle = false},
-      {.buffer = context->yCurrBuffer, .cycle = false},
-      {.buffer = context->xPrevBuffer, .cycle = false},
-      {.buffer = context->yPrevBuffer, .cycle = false},
-      {.buffer = context->massBuffer, .cycle = false},
-      {.buffer = context->densityBuffer, .cycle = false},
-  };
-  SDL_GPUComputePass *computePass = SDL_BeginGPUComputePass(
-      cmdBuf, NULL, 0, rwBindings, SDL_arraysize(rwBindings));
-  if (computePass == NULL) {
-    SDL_Log("SDL_BeginGPUComputePass failed: %s", SDL_GetError());
+  Sim *sim = &context->sim;
+  if (!Sim_Step(sim, cmdBuf)) {
     return SDL_APP_FAILURE;
   }
 
-  SDL_BindGPUComputePipeline(computePass, context->computePipeline);
+  // Read after the step, so the alive plane is the one finalize promoted.
+  const RenderParticles particles = {
+      .attributes = Sim_GetBuffer(sim, SIM_BINDING_PARTICLES),
+      .lists = Sim_GetBuffer(sim, SIM_BINDING_POOL_LISTS),
+      .capacity = sim->capacity,
+      .alivePlane = ParticlePool_GetAlivePlane(&sim->pool),
+      .indirectArgs = sim->pool.indirectBuffer,
+      .drawArgsOffset = POOL_DRAW_ARGS_OFFSET};
+
+  if (context->capturing) {
+    Capture *capture = &context->capture;
+    if (!Render_DrawToTexture(&context->render, cmdBuf, capture->texture,
+                              capture->width, capture->height, &particles)) {
+      return SDL_APP_FAILURE;
+    }
+    Render_PreviewTexture(cmdBuf, context->window, capture->texture,
+                          capture->width, capture->height);
+    // Submits the command buffer itself so it can attach a fence.
+    if (!Capture_SubmitFrame(capture, cmdBuf)) {
+      return SDL_APP_FAILURE;
+    }
+  } else if (context->softPresenting) {
+    // Drawn from a snapshot once the step is done, see below.
+    SDL_SubmitGPUCommandBuffer(cmdBuf);
+  } else {
+    if (!Render_Draw(&context->render, cmdBuf, context->window, &particles)) {
+      return SDL_APP_FAILURE;
+    }
 
-  SDL_GPUBuffer *computeBuffers[] = {
-      context->xCurrBuffer, context->yCurrBuffer, context->xPrevBuffer,
-      context->yPrevBuffer, context->massBuffer,  context->densityBuffer};
-  // Storage buffers bound at slots 0-5 to match shader bindings.
-  SDL_BindGPUComputeStorageBuffers(computePass, 0, computeBuffers,
-                                   SDL_arraysize(computeBuffers));
-  SDL_DispatchGPUCompute(computePass, groupCountX, 1, 1);
-  SDL_EndGPUComputePass(computePass);
+    // And finally, submit the command buffer for drawing. The
+    // driver will take over at this point and do all the rendering
+    // we've asked it to.
+    SDL_SubmitGPUCommandBuffer(cmdBuf);
+  }
 
-  if (!Render_Draw(&context->render, cmdBuf, context->window,
-                   context->xCurrBuffer, context->yCurrBuffer,
-                   context->numParticles)) {
+  // Snapshots go in their own command buffer, submitted after this frame's.
+  if (context->publishing &&
+      !Publisher_Step(&context->publisher, context->device, sim)) {
+    return SDL_APP_FAILURE;
+  }
+  if (context->softPresenting &&
+      !SoftPresent_Step(&context->softPresenter, context->device, sim)) {
     return SDL_APP_FAILURE;
   }
-
-  // And finally, submit the command buffer for drawing. The
-  // driver will take over at this point and do all the rendering
-  // we've asked it to.
-  SDL_SubmitGPUCommandBuffer(cmdBuf);
 
   // That's it for this frame.
   return SDL_APP_CONTINUE;
@@ -567,32 +687,22 @@ void SDL_AppQuit(void *appState, SDL_AppResult result) {
   // valid pointers as we go.
   if (context != NULL) {
     if (context->device != NULL) {
-      if (context->computePipeline != NULL) {
-        SDL_ReleaseGPUComputePipeline(context->device,
-                                      context->computePipeline);
-      }
-      Render_Destroy(&context->render, context->device);
-      if (context->xCurrBuffer != NULL) {
-        SDL_ReleaseGPUBuffer(context->device, context->xCurrBuffer);
-      }
-      if (context->yCurrBuffer != NULL) {
-        SDL_ReleaseGPUBuffer(context->device, context->yCurrBuffer);
-      }
-      if (context->xPrevBuffer != NULL) {
-        SDL_ReleaseGPUBuffer(context->device, context->xPrevBuffer);
+      if (context->capturing) {
+        Capture_Destroy(&context->capture, context->device);
       }
-      if (context->yPrevBuffer != NULL) {
-        SDL_ReleaseGPUBuffer(context->device, context->yPrevBuffer);
+      if (context->publishing) {
+        Publisher_Destroy(&context->publisher);
       }
-      if (context->massBuffer != NULL) {
-        SDL_ReleaseGPUBuffer(context->device, context->massBuffer);
-      }
-      if (context->densityBuffer != NULL) {
-        SDL_ReleaseGPUBuffer(context->device, context->densityBuffer);
+      if (context->softPresenting) {
+        SoftPresent_Destroy(&context->softPresenter);
       }
+      Render_Destroy(&context->render, context->device);
+      Sim_Destroy(&context->sim, context->device);
 
       if (context->window != NULL) {
-        SDL_ReleaseWindowFromGPUDevice(context->device, context->window);
+        if (context->windowClaimed) {
+          SDL_ReleaseWindowFromGPUDevice(context->device, context->window);
+        }
         SDL_DestroyWindow(context->window);
       }
 
@@ -0,0 +1,339 @@
+#include "particle_pool.h"
+
+#include "shader_utils.h"
+#include "sim_layout.h"
+
+static SDL_GPUBuffer *CreatePoolBuffer(SDL_GPUDevice *device,
+                                       SDL_GPUBufferUsageFlags usage,
+                                       Uint32 size) {
+  SDL_GPUBufferCreateInfo createInfo = {.usage = usage, .size = size};
+  return SDL_CreateGPUBuffer(device, &createInfo);
+}
+
+static void ReleasePoolBuffers(ParticlePool *pool, SDL_GPUDevice *device) {
+  SDL_GPUBuffer *buffers[] = {pool->listBuffer, pool->counterBuffer,
+                              pool->indirectBuffer};
+  for (size_t i = 0; i < SDL_arraysize(buffers); i++) {
+    if (buffers[i] != NULL) {
+      SDL_ReleaseGPUBuffer(device, buffers[i]);
+    }
+  }
+  pool->listBuffer = NULL;
+  pool->counterBuffer = NULL;
+  pool->indirectBuffer = NULL;
+}
+
+// Uploads the initial alive list, dead list, counters and indirect arguments
+// through a single staging buffer.
+static bool UploadInitialState(ParticlePool *pool, SDL_GPUDevice *device,
+                               Uint32 initialCount) {
+  const Uint32 listSize = sizeof(Uint32) * pool->capacity;
+  const Uint32 counterSize = sizeof(Uint32) * POOL_COUNTER_COUNT;
+  // The alive list starts out in POOL_LIST_ALIVE_A, directly followed in the
+  // staging buffer by the dead list.
+  const Uint32 deadOffset = listSize;
+  const Uint32 counterOffset = deadOffset + listSize;
+  const Uint32 argsOffset = counterOffset + counterSize;
+  const Uint32 stagingSize = argsOffset + POOL_INDIRECT_ARGS_SIZE;
+
+  SDL_GPUTransferBuffer *staging = SDL_CreateGPUTransferBuffer(
+      device, &(SDL_GPUTransferBufferCreateInfo){
+                  .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+                  .size = stagingSize});
+  if (staging == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't create pool transfer buffer: %s", SDL_GetError());
+    return false;
+  }
+
+  Uint8 *mapped = SDL_MapGPUTransferBuffer(device, staging, false);
+  if (mapped == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't map pool transfer buffer: %s", SDL_GetError());
+    SDL_ReleaseGPUTransferBuffer(device, staging);
+    return false;
+  }
+
+  const Uint32 deadCount = pool->capacity - initialCount;
+  Uint32 *alive = (Uint32 *)mapped;
+  Uint32 *dead = (Uint32 *)(mapped + deadOffset);
+  for (Uint32 i = 0; i < pool->capacity; i++) {
+    alive[i] = i < initialCount ? i : 0;
+    // Dead list is a stack; keep the lowest free slot on top.
+    dead[i] = i < deadCount ? pool->capacity - 1 - i : 0;
+  }
+
+  Uint32 *counters = (Uint32 *)(mapped + counterOffset);
+  SDL_memset(counters, 0, counterSize);
+  counters[POOL_COUNTER_ALIVE] = initialCount;
+  counters[POOL_COUNTER_DEAD] = deadCount;
+  // Nothing has been sorted into the grid yet.
+  counters[POOL_COUNTER_GRID_DIRTY] = 1;
+
+  SDL_memset(mapped + argsOffset, 0, POOL_INDIRECT_ARGS_SIZE);
+  const Uint32 dispatchOffsets[] = {POOL_DISPATCH_ARGS_OFFSET,
+                                    POOL_FIXED_DISPATCH_ARGS_OFFSET};
+  for (size_t i = 0; i < SDL_arraysize(dispatchOffsets); i++) {
+    SDL_GPUIndirectDispatchCommand *dispatchArgs =
+        (SDL_GPUIndirectDispatchCommand *)(mapped + argsOffset +
+                                           dispatchOffsets[i]);
+    *dispatchArgs =
+        ParticlePool_DispatchSize(initialCount, SIM_THREADGROUP_SIZE);
+  }
+  SDL_GPUIndirectDrawCommand *drawArgs =
+      (SDL_GPUIndirectDrawCommand *)(mapped + argsOffset +
+                                     POOL_DRAW_ARGS_OFFSET);
+  drawArgs->num_vertices = initialCount;
+  drawArgs->num_instances = 1;
+  drawArgs->first_vertex = 0;
+  drawArgs->first_instance = 0;
+
+  SDL_UnmapGPUTransferBuffer(device, staging);
+
+  SDL_GPUCommandBuffer *cmdBuf = SDL_AcquireGPUCommandBuffer(device);
+  if (cmdBuf == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't acquire command buffer for pool upload: %s",
+                 SDL_GetError());
+    SDL_ReleaseGPUTransferBuffer(device, staging);
+    return false;
+  }
+
+  SDL_GPUCopyPass *copyPass = SDL_BeginGPUCopyPass(cmdBuf);
+  struct {
+    SDL_GPUBuffer *buffer;
+    Uint32 offset;
+    Uint32 dstOffset;
+    Uint32 size;
+  } uploads[] = {
+      {pool->listBuffer, 0, listSize * pool->current, listSize},
+      {pool->listBuffer, deadOffset, listSize * POOL_LIST_DEAD, listSize},
+      {pool->counterBuffer, counterOffset, 0, counterSize},
+      {pool->indirectBuffer, argsOffset, 0, POOL_INDIRECT_ARGS_SIZE},
+  };
+  for (size_t i = 0; i < SDL_arraysize(uploads); i++) {
+    SDL_GPUTransferBufferLocation src = {.transfer_buffer = staging,
+                                         .offset = uploads[i].offset};
+    SDL_GPUBufferRegion dst = {.buffer = uploads[i].buffer,
+                               .offset = uploads[i].dstOffset,
+                               .size = uploads[i].size};
+    SDL_UploadToGPUBuffer(copyPass, &src, &dst, false);
+  }
+  SDL_EndGPUCopyPass(copyPass);
+  SDL_SubmitGPUCommandBuffer(cmdBuf);
+
+  SDL_ReleaseGPUTransferBuffer(device, staging);
+  return true;
+}
+
+bool ParticlePool_Init(ParticlePool *pool, SDL_GPUDevice *device,
+                       SDL_GPUShaderFormat shaderFormat,
+                       const char *emitShaderPath,
+                       const char *finalizeShaderPath, Uint32 capacity,
+                       Uint32 initialCount) {
+  SDL_zerop(pool);
+  if (capacity == 0 || initialCount > capacity) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Invalid particle pool size: %u of %u", initialCount,
+                 capacity);
+    return false;
+  }
+  pool->capacity = capacity;
+  pool->current = POOL_LIST_ALIVE_A;
+  pool->dispatchGroupSize = SIM_THREADGROUP_SIZE;
+  // The plane layout is valid before the first ParticlePool_PushUniforms, for
+  // passes recorded outside a step.
+  pool->uniforms.capacity = capacity;
+  pool->uniforms.dispatchGroupSize = pool->dispatchGroupSize;
+  pool->uniforms.aliveCurrent = (Uint32)pool->current;
+
+  // emitCS writes the particle attributes and the lists; finalizeCS also
+  // writes the indirect arguments in the extra slot after them.
+  pool->emitPipeline = CreateComputePipelineFromFile(
+      device, shaderFormat, emitShaderPath, "emitCS", SIM_BINDING_COUNT, 1,
+      SIM_THREADGROUP_SIZE);
+  pool->finalizePipeline = CreateComputePipelineFromFile(
+      device, shaderFormat, finalizeShaderPath, "finalizeCS",
+      SIM_BINDING_COUNT + 1, 1, 1);
+  if (pool->emitPipeline == NULL || pool->finalizePipeline == NULL) {
+    ParticlePool_Destroy(pool, device);
+    return false;
+  }
+
+  const SDL_GPUBufferUsageFlags listUsage =
+      SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ |
+      SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ |
+      SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE;
+  pool->listBuffer = CreatePoolBuffer(
+      device, listUsage, sizeof(Uint32) * capacity * POOL_LIST_COUNT);
+  pool->counterBuffer = CreatePoolBuffer(
+      device, listUsage, sizeof(Uint32) * POOL_COUNTER_COUNT);
+  pool->indirectBuffer = CreatePoolBuffer(
+      device,
+      SDL_GPU_BUFFERUSAGE_INDIRECT | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ |
+          SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE,
+      POOL_INDIRECT_ARGS_SIZE);
+  if (pool->listBuffer == NULL || pool->counterBuffer == NULL ||
+      pool->indirectBuffer == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't create particle pool buffers: %s", SDL_GetError());
+    ParticlePool_Destroy(pool, device);
+    return false;
+  }
+
+  if (!UploadInitialState(pool, device, initialCount)) {
+    ParticlePool_Destroy(pool, device);
+    return false;
+  }
+  return true;
+}
+
+void ParticlePool_Destroy(ParticlePool *pool, SDL_GPUDevice *device) {
+  if (pool == NULL || device == NULL) {
+    return;
+  }
+  if (pool->emitPipeline != NULL) {
+    SDL_ReleaseGPUComputePipeline(device, pool->emitPipeline);
+    pool->emitPipeline = NULL;
+  }
+  if (pool->finalizePipeline != NULL) {
+    SDL_ReleaseGPUComputePipeline(device, pool->finalizePipeline);
+    pool->finalizePipeline = NULL;
+  }
+  ReleasePoolBuffers(pool, device);
+}
+
+bool ParticlePool_AddEmitter(ParticlePool *pool,
+                             const ParticleEmitter *emitter) {
+  if (pool->numEmitters >= POOL_MAX_EMITTERS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Too many emitters (max %d)",
+                 POOL_MAX_EMITTERS);
+    return false;
+  }
+  pool->emitters[pool->numEmitters] = *emitter;
+  pool->emitterAccum[pool->numEmitters] = 0.0f;
+  pool->numEmitters++;
+  return true;
+}
+
+bool ParticlePool_AddSink(ParticlePool *pool, const ParticleSink *sink) {
+  if (pool->numSinks >= POOL_MAX_SINKS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Too many sinks (max %d)",
+                 POOL_MAX_SINKS);
+    return false;
+  }
+  pool->sinks[pool->numSinks++] = *sink;
+  return true;
+}
+
+void ParticlePool_PushUniforms(ParticlePool *pool,
+                               SDL_GPUCommandBuffer *cmdBuf) {
+  PoolUniforms *u = &pool->uniforms;
+  Uint32 spawnTotal = 0;
+  for (int i = 0; i < pool->numEmitters; i++) {
+    const ParticleEmitter *e = &pool->emitters[i];
+    // Whole spawns this frame; the remainder carries over. The pool clamps to
+    // the dead list on the GPU, so no CPU-side bookkeeping of free slots.
+    pool->emitterAccum[i] += e->rate;
+    Uint32 spawn = (Uint32)pool->emitterAccum[i];
+    spawn = SDL_min(spawn, pool->capacity);
+    pool->emitterAccum[i] -= (float)spawn;
+
+    u->emitterShape[i][0] = e->x;
+    u->emitterShape[i][1] = e->y;
+    u->emitterShape[i][2] = e->radius;
+    u->emitterShape[i][3] = 0.0f;
+    u->emitterVelocity[i][0] = e->velX;
+    u->emitterVelocity[i][1] = e->velY;
+    u->emitterVelocity[i][2] = 0.0f;
+    u->emitterVelocity[i][3] = 0.0f;
+    u->emitterRange[i][0] = spawnTotal;
+    u->emitterRange[i][1] = spawn;
+    u->emitterRange[i][2] = e->scene;
+    spawnTotal += spawn;
+  }
+  for (int i = 0; i < pool->numSinks; i++) {
+    u->sinks[i][0] = pool->sinks[i].x;
+    u->sinks[i][1] = pool->sinks[i].y;
+    u->sinks[i][2] = pool->sinks[i].radius;
+    u->sinks[i][3] = 0.0f;
+  }
+  u->numEmitters = (Uint32)pool->numEmitters;
+  u->numSinks = (Uint32)pool->numSinks;
+  u->spawnTotal = SDL_min(spawnTotal, pool->capacity);
+  u->capacity = pool->capacity;
+  u->dispatchGroupSize = pool->dispatchGroupSize;
+  u->aliveCurrent = (Uint32)pool->current;
+  u->frame++;
+
+  SDL_PushGPUComputeUniformData(cmdBuf, 0, u, sizeof(*u));
+}
+
+void ParticlePool_FillBindings(const ParticlePool *pool,
+                               SDL_GPUStorageBufferReadWriteBinding *bindings) {
+  bindings[SIM_BINDING_POOL_LISTS] = (SDL_GPUStorageBufferReadWriteBinding){
+      .buffer = pool->listBuffer, .cycle = false};
+  bindings[SIM_BINDING_COUNTERS] = (SDL_GPUStorageBufferReadWriteBinding){
+      .buffer = pool->counterBuffer, .cycle = false};
+}
+
+bool ParticlePool_Emit(ParticlePool *pool, SDL_GPUCommandBuffer *cmdBuf,
+                       const SDL_GPUStorageBufferReadWriteBinding *bindings) {
+  if (pool->uniforms.spawnTotal == 0) {
+    return true;
+  }
+
+  // Separate pass so the dead-list pushes from the simulation pass are
+  // visible before we pop from it.
+  SDL_GPUComputePass *pass =
+      SDL_BeginGPUComputePass(cmdBuf, NULL, 0, bindings, SIM_BINDING_COUNT);
+  if (pass == NULL) {
+    SDL_Log("SDL_BeginGPUComputePass (emit) failed: %s", SDL_GetError());
+    return false;
+  }
+  SDL_BindGPUComputePipeline(pass, pool->emitPipeline);
+  const SDL_GPUIndirectDispatchCommand groups = ParticlePool_DispatchSize(
+      pool->uniforms.spawnTotal, SIM_THREADGROUP_SIZE);
+  SDL_DispatchGPUCompute(pass, groups.groupcount_x, groups.groupcount_y,
+                         groups.groupcount_z);
+  SDL_EndGPUComputePass(pass);
+  return true;
+}
+
+bool ParticlePool_Finalize(ParticlePool *pool, SDL_GPUCommandBuffer *cmdBuf,
+                           const SDL_GPUStorageBufferReadWriteBinding *bindings) {
+  SDL_GPUStorageBufferReadWriteBinding finalizeBindings[SIM_BINDING_COUNT + 1];
+  SDL_memcpy(finalizeBindings, bindings,
+             sizeof(*bindings) * SIM_BINDING_COUNT);
+  finalizeBindings[SIM_BINDING_INDIRECT_ARGS] =
+      (SDL_GPUStorageBufferReadWriteBinding){.buffer = pool->indirectBuffer,
+                                             .cycle = false};
+
+  SDL_GPUComputePass *pass = SDL_BeginGPUComputePass(
+      cmdBuf, NULL, 0, finalizeBindings, SDL_arraysize(finalizeBindings));
+  if (pass == NULL) {
+    SDL_Log("SDL_BeginGPUComputePass (finalize) failed: %s", SDL_GetError());
+    return false;
+  }
+  SDL_BindGPUComputePipeline(pass, pool->finalizePipeline);
+  SDL_DispatchGPUCompute(pass, 1, 1, 1);
+  SDL_EndGPUComputePass(pass);
+
+  pool->current = pool->current == POOL_LIST_ALIVE_A ? POOL_LIST_ALIVE_B
+                                                     : POOL_LIST_ALIVE_A;
+  return true;
+}
+
+SDL_GPUIndirectDispatchCommand ParticlePool_DispatchSize(Uint32 threads,
+                                                         Uint32 groupSize) {
+  const Uint32 groups = (Uint32)(((Uint64)threads + groupSize - 1) / groupSize);
+  return (SDL_GPUIndirectDispatchCommand){
+      .groupcount_x = SDL_min(groups, (Uint32)SIM_DISPATCH_ROW_GROUPS),
+      .groupcount_y = (groups + SIM_DISPATCH_ROW_GROUPS - 1) /
+                      SIM_DISPATCH_ROW_GROUPS,
+      .groupcount_z = 1};
+}
+
+PoolListPlane ParticlePool_GetAlivePlane(const ParticlePool *pool) {
+  return pool->current;
+}
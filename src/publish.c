@@ -0,0 +1,537 @@
+#include "publish.h"
+
+#include "shader_utils.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Shared slots readers pick from. More slots give slow readers longer before
+// the writer comes back around to the one they are reading.
+#define PUBLISH_SHARED_SLOTS 4
+#define PUBLISH_ALIGN 64
+// Headroom over the last alive count when sizing a download, for particles
+// spawned in the frames it trails by.
+#define PUBLISH_ROW_SLACK 1024
+// Copies a reader attempts before giving up on a frame. The writer leaves a
+// slot alone for PUBLISH_SHARED_SLOTS - 1 frames, so a retry almost always
+// lands.
+#define PUBLISH_READ_ATTEMPTS 16
+// How long --publish-read waits for the first frame.
+#define PUBLISH_READ_TIMEOUT_MS 5000
+
+static size_t AlignUp(size_t size) {
+  return (size + PUBLISH_ALIGN - 1) & ~(size_t)(PUBLISH_ALIGN - 1);
+}
+
+#ifdef _WIN32
+static Uint8 *MapShared(Publisher *publisher) {
+  HANDLE mapping = CreateFileMappingA(
+      INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+      (DWORD)((Uint64)publisher->sharedSize >> 32),
+      (DWORD)(publisher->sharedSize & 0xFFFFFFFFu), publisher->name);
+  if (mapping == NULL) {
+    SDL_SetError("CreateFileMapping failed (%lu)", GetLastError());
+    return NULL;
+  }
+  void *view =
+      MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, publisher->sharedSize);
+  if (view == NULL) {
+    SDL_SetError("MapViewOfFile failed (%lu)", GetLastError());
+    CloseHandle(mapping);
+    return NULL;
+  }
+  publisher->handle = mapping;
+  return (Uint8 *)view;
+}
+
+static void UnmapShared(Publisher *publisher) {
+  UnmapViewOfFile(publisher->shared);
+  CloseHandle((HANDLE)publisher->handle);
+}
+
+static bool MapReader(PublishReader *reader, const char *name) {
+  HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+  if (mapping == NULL) {
+    SDL_SetError("OpenFileMapping failed (%lu)", GetLastError());
+    return false;
+  }
+  void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  MEMORY_BASIC_INFORMATION info;
+  if (view == NULL || VirtualQuery(view, &info, sizeof(info)) == 0) {
+    SDL_SetError("MapViewOfFile failed (%lu)", GetLastError());
+    if (view != NULL) {
+      UnmapViewOfFile(view);
+    }
+    CloseHandle(mapping);
+    return false;
+  }
+  reader->shared = (const Uint8 *)view;
+  reader->sharedSize = info.RegionSize;
+  reader->handle = mapping;
+  return true;
+}
+
+static void UnmapReader(PublishReader *reader) {
+  UnmapViewOfFile(reader->shared);
+  CloseHandle((HANDLE)reader->handle);
+}
+#else
+static Uint8 *MapShared(Publisher *publisher) {
+  int fd = shm_open(publisher->name, O_CREAT | O_RDWR, 0600);
+  if (fd < 0) {
+    SDL_SetError("shm_open failed: %s", strerror(errno));
+    return NULL;
+  }
+  if (ftruncate(fd, (off_t)publisher->sharedSize) != 0) {
+    SDL_SetError("ftruncate failed: %s", strerror(errno));
+    close(fd);
+    shm_unlink(publisher->name);
+    return NULL;
+  }
+  void *view = mmap(NULL, publisher->sharedSize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+  // The mapping keeps the object alive.
+  close(fd);
+  if (view == MAP_FAILED) {
+    SDL_SetError("mmap failed: %s", strerror(errno));
+    shm_unlink(publisher->name);
+    return NULL;
+  }
+  return (Uint8 *)view;
+}
+
+static void UnmapShared(Publisher *publisher) {
+  munmap(publisher->shared, publisher->sharedSize);
+  shm_unlink(publisher->name);
+}
+
+static bool MapReader(PublishReader *reader, const char *name) {
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    SDL_SetError("shm_open failed: %s", strerror(errno));
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    SDL_SetError("fstat failed: %s", strerror(errno));
+    close(fd);
+    return false;
+  }
+  void *view = NULL;
+  if (info.st_size > 0) {
+    view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (view == NULL || view == MAP_FAILED) {
+    SDL_SetError("mmap failed: %s",
+                 view == NULL ? "empty object" : strerror(errno));
+    return false;
+  }
+  reader->shared = (const Uint8 *)view;
+  reader->sharedSize = (size_t)info.st_size;
+  return true;
+}
+
+static void UnmapReader(PublishReader *reader) {
+  munmap((void *)reader->shared, reader->sharedSize);
+}
+#endif
+
+// Runs on the readback worker, the only writer of the shared slots. data
+// holds the counters, then each packed block cut to the rows downloaded.
+static void WritePublishedFrame(void *userdata, const Uint8 *data, Uint32 size,
+                                Uint64 frame) {
+  (void)size;
+  Publisher *publisher = (Publisher *)userdata;
+  PublishHeader *header = (PublishHeader *)publisher->shared;
+
+  const Uint32 rows = publisher->rows[publisher->consumed++ %
+                                      PUBLISH_RING_SLOTS];
+  const Uint32 *counters = (const Uint32 *)data;
+  const Uint32 count =
+      SDL_min(counters[POOL_COUNTER_ALIVE], publisher->capacity);
+  SDL_SetAtomicU32(&publisher->lastAlive, count);
+  if (count > rows) {
+    // The download stopped short of the live set; the next one is sized
+    // from this count.
+    publisher->truncated++;
+    return;
+  }
+  const Uint8 *packed = data + sizeof(Uint32) * POOL_COUNTER_COUNT;
+
+  Uint8 *slot = publisher->shared + header->headerSize +
+                (size_t)publisher->nextSlot * header->slotSize;
+  PublishSlotHeader *slotHeader = (PublishSlotHeader *)slot;
+
+  // Odd while the slot is inconsistent.
+  const Uint32 sequence = SDL_GetAtomicU32(&slotHeader->sequence);
+  SDL_SetAtomicU32(&slotHeader->sequence, sequence + 1);
+  SDL_MemoryBarrierRelease();
+
+  for (int b = 0; b < PUBLISH_BLOCK_COUNT; b++) {
+    SDL_memcpy(slot + AlignUp(sizeof(PublishSlotHeader)) +
+                   (size_t)b * header->blockSize,
+               packed + sizeof(Uint32) * (size_t)b * rows,
+               sizeof(Uint32) * (size_t)count);
+  }
+  slotHeader->count = count;
+  slotHeader->frame = frame;
+
+  SDL_MemoryBarrierRelease();
+  SDL_SetAtomicU32(&slotHeader->sequence, sequence + 2);
+
+  SDL_SetAtomicU32(&header->published, ++publisher->published);
+  publisher->nextSlot = (publisher->nextSlot + 1) % PUBLISH_SHARED_SLOTS;
+}
+
+bool Publisher_Init(Publisher *publisher, SDL_GPUDevice *device,
+                    SDL_GPUShaderFormat shaderFormat, const Sim *sim,
+                    const PublishSettings *settings) {
+  SDL_zerop(publisher);
+  if (settings->name == NULL || settings->name[0] == '\0' ||
+      SDL_strlen(settings->name) >= sizeof(publisher->name)) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Invalid shared-memory name for publishing");
+    return false;
+  }
+  SDL_strlcpy(publisher->name, settings->name, sizeof(publisher->name));
+  publisher->every = settings->every > 0 ? settings->every : 1;
+  publisher->capacity = sim->capacity;
+  publisher->device = device;
+  // Nothing downloaded yet, so the first download takes every row.
+  SDL_SetAtomicU32(&publisher->lastAlive, sim->capacity);
+
+  // Reads the sim's bindings and writes the pack buffer in the slot after
+  // them.
+  char packPath[256];
+  BuildShaderPath(packPath, sizeof(packPath), "publishpack", shaderFormat);
+  publisher->packPipeline = CreateComputePipelineFromFile(
+      device, shaderFormat, packPath, "publishPackCS", SIM_BINDING_COUNT + 1,
+      1, SIM_THREADGROUP_SIZE);
+  const Uint32 packSize =
+      (Uint32)(sizeof(Uint32) * sim->capacity * PUBLISH_BLOCK_COUNT);
+  publisher->packBuffer = SDL_CreateGPUBuffer(
+      device, &(SDL_GPUBufferCreateInfo){
+                  .usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE,
+                  .size = packSize});
+  if (publisher->packPipeline == NULL || publisher->packBuffer == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't create publish pack pass: %s", SDL_GetError());
+    Publisher_Destroy(publisher);
+    return false;
+  }
+
+  const size_t headerSize = AlignUp(sizeof(PublishHeader));
+  const size_t blockSize = AlignUp(sizeof(Uint32) * (size_t)sim->capacity);
+  const size_t slotSize = AlignUp(sizeof(PublishSlotHeader)) +
+                          blockSize * PUBLISH_BLOCK_COUNT;
+  publisher->sharedSize = headerSize + slotSize * PUBLISH_SHARED_SLOTS;
+
+  publisher->shared = MapShared(publisher);
+  if (publisher->shared == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't map shared memory %s: %s", publisher->name,
+                 SDL_GetError());
+    return false;
+  }
+  SDL_memset(publisher->shared, 0, publisher->sharedSize);
+
+  PublishHeader *header = (PublishHeader *)publisher->shared;
+  header->numSlots = PUBLISH_SHARED_SLOTS;
+  header->capacity = sim->capacity;
+  header->headerSize = (Uint32)headerSize;
+  header->slotSize = (Uint32)slotSize;
+  header->blockSize = (Uint32)blockSize;
+  header->version = PUBLISH_VERSION;
+  // Last, so readers that see the magic see a complete header.
+  SDL_MemoryBarrierRelease();
+  header->magic = PUBLISH_MAGIC;
+
+  // Counters, then the packed blocks; downloads fill only a prefix.
+  if (!Readback_Init(&publisher->ring, device,
+                     (Uint32)(sizeof(Uint32) * POOL_COUNTER_COUNT) + packSize,
+                     PUBLISH_RING_SLOTS, WritePublishedFrame, publisher,
+                     "publish-writer")) {
+    Publisher_Destroy(publisher);
+    return false;
+  }
+
+  SDL_Log("Publishing every %u steps to shared memory %s (%zu bytes)",
+          publisher->every, publisher->name, publisher->sharedSize);
+  return true;
+}
+
+void Publisher_Destroy(Publisher *publisher) {
+  if (publisher == NULL) {
+    return;
+  }
+  // Drains every in-flight snapshot through the writer before unmapping.
+  Readback_Destroy(&publisher->ring);
+  if (publisher->truncated > 0) {
+    SDL_Log("Skipped %u published frames that outgrew their download",
+            publisher->truncated);
+  }
+  if (publisher->shared != NULL) {
+    UnmapShared(publisher);
+    publisher->shared = NULL;
+  }
+  if (publisher->packBuffer != NULL) {
+    SDL_ReleaseGPUBuffer(publisher->device, publisher->packBuffer);
+    publisher->packBuffer = NULL;
+  }
+  if (publisher->packPipeline != NULL) {
+    SDL_ReleaseGPUComputePipeline(publisher->device, publisher->packPipeline);
+    publisher->packPipeline = NULL;
+  }
+}
+
+bool Publisher_Step(Publisher *publisher, SDL_GPUDevice *device,
+                    const Sim *sim) {
+  const Uint64 step = publisher->steps++;
+  if (step % publisher->every != 0) {
+    // Keep finished downloads moving to the writer between publishes.
+    Readback_Poll(&publisher->ring);
+    return true;
+  }
+
+  SDL_GPUTransferBuffer *transfer = Readback_Acquire(&publisher->ring);
+  if (transfer == NULL) {
+    // Writer or GPU is behind; drop this frame rather than wait.
+    return true;
+  }
+
+  // A command buffer of our own, so the frame's submit stays untouched.
+  // Submission order puts it after the step it snapshots.
+  SDL_GPUCommandBuffer *cmdBuf = SDL_AcquireGPUCommandBuffer(device);
+  if (cmdBuf == NULL) {
+    SDL_Log("SDL_AcquireGPUCommandBuffer (publish) failed: %s",
+            SDL_GetError());
+    return false;
+  }
+
+  // The step swapped the alive lists after its passes, so point the pack at
+  // the list finalize promoted.
+  PoolUniforms uniforms = sim->pool.uniforms;
+  uniforms.aliveCurrent = (Uint32)ParticlePool_GetAlivePlane(&sim->pool);
+  SDL_PushGPUComputeUniformData(cmdBuf, 0, &uniforms, sizeof(uniforms));
+
+  SDL_GPUStorageBufferReadWriteBinding bindings[SIM_BINDING_COUNT + 1];
+  for (int i = 0; i < SIM_BINDING_COUNT; i++) {
+    bindings[i] = (SDL_GPUStorageBufferReadWriteBinding){
+        .buffer = Sim_GetBuffer(sim, (SimBinding)i), .cycle = false};
+  }
+  bindings[SIM_BINDING_COUNT] = (SDL_GPUStorageBufferReadWriteBinding){
+      .buffer = publisher->packBuffer, .cycle = false};
+  SDL_GPUComputePass *computePass = SDL_BeginGPUComputePass(
+      cmdBuf, NULL, 0, bindings, SDL_arraysize(bindings));
+  if (computePass == NULL) {
+    SDL_Log("SDL_BeginGPUComputePass (publish) failed: %s", SDL_GetError());
+    SDL_CancelGPUCommandBuffer(cmdBuf);
+    return false;
+  }
+  SDL_BindGPUComputePipeline(computePass, publisher->packPipeline);
+  SDL_DispatchGPUComputeIndirect(computePass, sim->pool.indirectBuffer,
+                                 POOL_FIXED_DISPATCH_ARGS_OFFSET);
+  SDL_EndGPUComputePass(computePass);
+
+  // The live count is only known on the GPU; size the download from the
+  // last one the writer saw.
+  const Uint32 lastAlive = SDL_GetAtomicU32(&publisher->lastAlive);
+  const Uint32 rows =
+      (Uint32)SDL_min((Uint64)lastAlive + lastAlive / 4 + PUBLISH_ROW_SLACK,
+                      (Uint64)publisher->capacity);
+
+  SDL_GPUCopyPass *copyPass = SDL_BeginGPUCopyPass(cmdBuf);
+  if (copyPass == NULL) {
+    SDL_Log("SDL_BeginGPUCopyPass (publish) failed: %s", SDL_GetError());
+    SDL_CancelGPUCommandBuffer(cmdBuf);
+    return false;
+  }
+  Uint32 offset = 0;
+  SDL_GPUBufferRegion counters = {.buffer = sim->pool.counterBuffer,
+                                  .offset = 0,
+                                  .size = sizeof(Uint32) * POOL_COUNTER_COUNT};
+  SDL_DownloadFromGPUBuffer(
+      copyPass, &counters,
+      &(SDL_GPUTransferBufferLocation){.transfer_buffer = transfer,
+                                       .offset = offset});
+  offset += counters.size;
+  for (Uint32 b = 0; b < PUBLISH_BLOCK_COUNT && rows > 0; b++) {
+    SDL_GPUBufferRegion block = {
+        .buffer = publisher->packBuffer,
+        .offset = (Uint32)(sizeof(Uint32) * publisher->capacity * b),
+        .size = (Uint32)(sizeof(Uint32) * rows)};
+    SDL_DownloadFromGPUBuffer(
+        copyPass, &block,
+        &(SDL_GPUTransferBufferLocation){.transfer_buffer = transfer,
+                                         .offset = offset});
+    offset += block.size;
+  }
+  SDL_EndGPUCopyPass(copyPass);
+
+  SDL_GPUFence *fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdBuf);
+  if (fence == NULL) {
+    SDL_Log("SDL_SubmitGPUCommandBufferAndAcquireFence failed: %s",
+            SDL_GetError());
+    return false;
+  }
+  // Read by the worker once the ring hands it this slot.
+  publisher->rows[publisher->commits++ % PUBLISH_RING_SLOTS] = rows;
+  Readback_Commit(&publisher->ring, fence, step);
+  return true;
+}
+
+bool PublishReader_Open(PublishReader *reader, const char *name) {
+  SDL_zerop(reader);
+  if (!MapReader(reader, name)) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't map shared memory %s: %s", name, SDL_GetError());
+    return false;
+  }
+
+  const PublishHeader *header = (const PublishHeader *)reader->shared;
+  bool valid = reader->sharedSize >= sizeof(PublishHeader) &&
+               header->magic == PUBLISH_MAGIC;
+  // Pairs with the release before the writer stores the magic.
+  SDL_MemoryBarrierAcquire();
+  if (valid && header->version != PUBLISH_VERSION) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Shared memory %s has version %u, expected %u", name,
+                 header->version, PUBLISH_VERSION);
+    PublishReader_Close(reader);
+    return false;
+  }
+  if (valid) {
+    const Uint64 blocksEnd = AlignUp(sizeof(PublishSlotHeader)) +
+                             (Uint64)header->blockSize * PUBLISH_BLOCK_COUNT;
+    const Uint64 end =
+        header->headerSize + (Uint64)header->slotSize * header->numSlots;
+    valid = header->numSlots > 0 &&
+            header->headerSize >= sizeof(PublishHeader) &&
+            header->blockSize >= sizeof(Uint32) * (Uint64)header->capacity &&
+            header->slotSize >= blocksEnd && end <= reader->sharedSize;
+  }
+  if (!valid) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Shared memory %s is not a particle publish ring", name);
+    PublishReader_Close(reader);
+    return false;
+  }
+  reader->numSlots = header->numSlots;
+  reader->capacity = header->capacity;
+  reader->headerSize = header->headerSize;
+  reader->slotSize = header->slotSize;
+  reader->blockSize = header->blockSize;
+  return true;
+}
+
+void PublishReader_Close(PublishReader *reader) {
+  if (reader == NULL || reader->shared == NULL) {
+    return;
+  }
+  UnmapReader(reader);
+  reader->shared = NULL;
+}
+
+bool PublishReader_ReadLatest(const PublishReader *reader,
+                              Uint32 *const blocks[PUBLISH_BLOCK_COUNT],
+                              Uint32 *outCount, Uint64 *outFrame) {
+  PublishHeader *header = (PublishHeader *)reader->shared;
+  for (int attempt = 0; attempt < PUBLISH_READ_ATTEMPTS; attempt++) {
+    const Uint32 published = SDL_GetAtomicU32(&header->published);
+    if (published == 0) {
+      return false;
+    }
+    const Uint8 *slot = reader->shared + reader->headerSize +
+                        (size_t)((published - 1) % reader->numSlots) *
+                            reader->slotSize;
+    PublishSlotHeader *slotHeader = (PublishSlotHeader *)slot;
+
+    const Uint32 before = SDL_GetAtomicU32(&slotHeader->sequence);
+    if (before & 1) {
+      // The writer has lapped us and is refilling this slot.
+      continue;
+    }
+    SDL_MemoryBarrierAcquire();
+    const Uint32 count = SDL_min(slotHeader->count, reader->capacity);
+    const Uint64 frame = slotHeader->frame;
+    for (int b = 0; b < PUBLISH_BLOCK_COUNT; b++) {
+      SDL_memcpy(blocks[b],
+                 slot + AlignUp(sizeof(PublishSlotHeader)) +
+                     (size_t)b * reader->blockSize,
+                 sizeof(Uint32) * (size_t)count);
+    }
+    SDL_MemoryBarrierAcquire();
+    if (SDL_GetAtomicU32(&slotHeader->sequence) != before) {
+      continue;
+    }
+    *outCount = count;
+    *outFrame = frame;
+    return true;
+  }
+  return false;
+}
+
+bool PublishReader_Check(const char *name) {
+  PublishReader reader;
+  if (!PublishReader_Open(&reader, name)) {
+    return false;
+  }
+
+  Uint32 *blocks[PUBLISH_BLOCK_COUNT] = {0};
+  bool ok = true;
+  for (int b = 0; b < PUBLISH_BLOCK_COUNT && ok; b++) {
+    blocks[b] = (Uint32 *)SDL_malloc(sizeof(Uint32) *
+                                     SDL_max(reader.capacity, 1u));
+    ok = blocks[b] != NULL;
+  }
+
+  Uint32 count = 0;
+  Uint64 frame = 0;
+  bool read = false;
+  const Uint64 deadline = SDL_GetTicks() + PUBLISH_READ_TIMEOUT_MS;
+  while (ok && !read) {
+    read = PublishReader_ReadLatest(&reader, blocks, &count, &frame);
+    if (!read && SDL_GetTicks() >= deadline) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "No consistent frame in %s after %u ms", name,
+                   PUBLISH_READ_TIMEOUT_MS);
+      ok = false;
+    } else if (!read) {
+      SDL_Delay(10);
+    }
+  }
+
+  if (ok) {
+    double sumX = 0.0;
+    double sumY = 0.0;
+    for (Uint32 k = 0; k < count; k++) {
+      float x;
+      float y;
+      SDL_memcpy(&x, &blocks[PUBLISH_BLOCK_X][k], sizeof(x));
+      SDL_memcpy(&y, &blocks[PUBLISH_BLOCK_Y][k], sizeof(y));
+      sumX += x;
+      sumY += y;
+    }
+    const double n = count > 0 ? (double)count : 1.0;
+    SDL_Log("%s: version %u, %u slots, capacity %u; frame %" SDL_PRIu64
+            ": %u particles, mean position (%.4f, %.4f)",
+            name, PUBLISH_VERSION, reader.numSlots, reader.capacity, frame,
+            count, sumX / n, sumY / n);
+  }
+
+  for (int b = 0; b < PUBLISH_BLOCK_COUNT; b++) {
+    SDL_free(blocks[b]);
+  }
+  PublishReader_Close(&reader);
+  return ok;
+}
@@ -0,0 +1,178 @@
+#include "readback.h"
+
+static int ReadbackWorker(void *data) {
+  ReadbackRing *ring = (ReadbackRing *)data;
+  // The worker walks the ring in the same round-robin order the main thread
+  // queues it, so it only needs its own cursor.
+  int next = 0;
+
+  SDL_LockMutex(ring->lock);
+  for (;;) {
+    ReadbackSlot *slot = &ring->slots[next];
+    while (slot->state != READBACK_SLOT_QUEUED && !ring->quit) {
+      SDL_WaitCondition(ring->wake, ring->lock);
+    }
+    if (slot->state != READBACK_SLOT_QUEUED) {
+      break;
+    }
+    SDL_UnlockMutex(ring->lock);
+
+    ring->consume(ring->userdata, slot->mapped, ring->slotSize, slot->frame);
+
+    SDL_LockMutex(ring->lock);
+    slot->state = READBACK_SLOT_DONE;
+    next = (next + 1) % ring->numSlots;
+  }
+  SDL_UnlockMutex(ring->lock);
+  return 0;
+}
+
+bool Readback_Init(ReadbackRing *ring, SDL_GPUDevice *device, Uint32 slotSize,
+                   int numSlots, ReadbackConsumeFn consume, void *userdata,
+                   const char *threadName) {
+  SDL_zerop(ring);
+  if (numSlots < 1 || numSlots > READBACK_MAX_SLOTS) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Readback ring needs 1-%d slots, got %d", READBACK_MAX_SLOTS,
+                 numSlots);
+    return false;
+  }
+  ring->device = device;
+  ring->numSlots = numSlots;
+  ring->slotSize = slotSize;
+  ring->consume = consume;
+  ring->userdata = userdata;
+
+  for (int i = 0; i < numSlots; i++) {
+    ring->slots[i].transfer = SDL_CreateGPUTransferBuffer(
+        device, &(SDL_GPUTransferBufferCreateInfo){
+                    .usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD,
+                    .size = slotSize});
+    if (ring->slots[i].transfer == NULL) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Couldn't create readback transfer buffer: %s",
+                   SDL_GetError());
+      Readback_Destroy(ring);
+      return false;
+    }
+  }
+
+  ring->lock = SDL_CreateMutex();
+  ring->wake = SDL_CreateCondition();
+  if (ring->lock == NULL || ring->wake == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't create readback sync objects: %s", SDL_GetError());
+    Readback_Destroy(ring);
+    return false;
+  }
+
+  ring->thread = SDL_CreateThread(ReadbackWorker, threadName, ring);
+  if (ring->thread == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't start readback thread: %s", SDL_GetError());
+    Readback_Destroy(ring);
+    return false;
+  }
+  return true;
+}
+
+void Readback_Poll(ReadbackRing *ring) {
+  SDL_LockMutex(ring->lock);
+  // Recycle slots the worker has finished with.
+  for (int i = 0; i < ring->numSlots; i++) {
+    ReadbackSlot *slot = &ring->slots[i];
+    if (slot->state == READBACK_SLOT_DONE) {
+      SDL_UnmapGPUTransferBuffer(ring->device, slot->transfer);
+      SDL_ReleaseGPUFence(ring->device, slot->fence);
+      slot->fence = NULL;
+      slot->mapped = NULL;
+      slot->state = READBACK_SLOT_FREE;
+    }
+  }
+
+  // Hand completed downloads to the worker, oldest first.
+  bool queued = false;
+  for (;;) {
+    ReadbackSlot *slot = &ring->slots[ring->mapTail];
+    if (slot->state != READBACK_SLOT_IN_FLIGHT ||
+        !SDL_QueryGPUFence(ring->device, slot->fence)) {
+      break;
+    }
+    slot->mapped = SDL_MapGPUTransferBuffer(ring->device, slot->transfer, false);
+    if (slot->mapped == NULL) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Couldn't map readback buffer: %s", SDL_GetError());
+      break;
+    }
+    slot->state = READBACK_SLOT_QUEUED;
+    ring->mapTail = (ring->mapTail + 1) % ring->numSlots;
+    queued = true;
+  }
+  if (queued) {
+    SDL_SignalCondition(ring->wake);
+  }
+  SDL_UnlockMutex(ring->lock);
+}
+
+SDL_GPUTransferBuffer *Readback_Acquire(ReadbackRing *ring) {
+  Readback_Poll(ring);
+  SDL_LockMutex(ring->lock);
+  ReadbackSlot *slot = &ring->slots[ring->head];
+  bool free = slot->state == READBACK_SLOT_FREE;
+  SDL_UnlockMutex(ring->lock);
+  return free ? slot->transfer : NULL;
+}
+
+void Readback_Commit(ReadbackRing *ring, SDL_GPUFence *fence, Uint64 frame) {
+  SDL_LockMutex(ring->lock);
+  ReadbackSlot *slot = &ring->slots[ring->head];
+  slot->fence = fence;
+  slot->frame = frame;
+  slot->state = READBACK_SLOT_IN_FLIGHT;
+  ring->head = (ring->head + 1) % ring->numSlots;
+  SDL_UnlockMutex(ring->lock);
+}
+
+void Readback_Destroy(ReadbackRing *ring) {
+  if (ring == NULL || ring->device == NULL) {
+    return;
+  }
+
+  if (ring->thread != NULL) {
+    // Drain everything still in flight so no captured frame is lost.
+    for (int i = 0; i < ring->numSlots; i++) {
+      ReadbackSlot *slot = &ring->slots[i];
+      if (slot->state == READBACK_SLOT_IN_FLIGHT) {
+        SDL_WaitForGPUFences(ring->device, true, &slot->fence, 1);
+      }
+    }
+    Readback_Poll(ring);
+
+    SDL_LockMutex(ring->lock);
+    ring->quit = true;
+    SDL_BroadcastCondition(ring->wake);
+    SDL_UnlockMutex(ring->lock);
+    SDL_WaitThread(ring->thread, NULL);
+    ring->thread = NULL;
+  }
+
+  for (int i = 0; i < ring->numSlots; i++) {
+    ReadbackSlot *slot = &ring->slots[i];
+    if (slot->mapped != NULL) {
+      SDL_UnmapGPUTransferBuffer(ring->device, slot->transfer);
+    }
+    if (slot->fence != NULL) {
+      SDL_ReleaseGPUFence(ring->device, slot->fence);
+    }
+    if (slot->transfer != NULL) {
+      SDL_ReleaseGPUTransferBuffer(ring->device, slot->transfer);
+    }
+  }
+  if (ring->wake != NULL) {
+    SDL_DestroyCondition(ring->wake);
+  }
+  if (ring->lock != NULL) {
+    SDL_DestroyMutex(ring->lock);
+  }
+  SDL_zerop(ring);
+}
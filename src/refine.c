@@ -0,0 +1,83 @@
+#include "refine.h"
+
+#include "particle_pool.h"
+#include "shader_utils.h"
+#include "sim_layout.h"
+
+bool ParticleRefiner_Init(ParticleRefiner *refiner, SDL_GPUDevice *device,
+                          SDL_GPUShaderFormat shaderFormat) {
+  SDL_zerop(refiner);
+
+  struct {
+    const char *stage;
+    const char *entrypoint;
+    SDL_GPUComputePipeline **pipeline;
+  } stages[] = {
+      {"mergepropose", "mergeProposeCS", &refiner->proposePipeline},
+      {"merge", "mergeCS", &refiner->mergePipeline},
+      {"split", "splitCS", &refiner->splitPipeline},
+  };
+  for (size_t i = 0; i < SDL_arraysize(stages); i++) {
+    char path[256];
+    BuildShaderPath(path, sizeof(path), stages[i].stage, shaderFormat);
+    // Pool uniforms in slot 0, grid uniforms in slot 1.
+    *stages[i].pipeline = CreateComputePipelineFromFile(
+        device, shaderFormat, path, stages[i].entrypoint, SIM_BINDING_COUNT, 2,
+        SIM_THREADGROUP_SIZE);
+    if (*stages[i].pipeline == NULL) {
+      ParticleRefiner_Destroy(refiner, device);
+      return false;
+    }
+  }
+  return true;
+}
+
+void ParticleRefiner_Destroy(ParticleRefiner *refiner, SDL_GPUDevice *device) {
+  if (refiner == NULL || device == NULL) {
+    return;
+  }
+  SDL_GPUComputePipeline **pipelines[] = {&refiner->proposePipeline,
+                                          &refiner->mergePipeline,
+                                          &refiner->splitPipeline};
+  for (size_t i = 0; i < SDL_arraysize(pipelines); i++) {
+    if (*pipelines[i] != NULL) {
+      SDL_ReleaseGPUComputePipeline(device, *pipelines[i]);
+      *pipelines[i] = NULL;
+    }
+  }
+}
+
+// One pass over last step's live count, so each stage sees the previous
+// one's writes. Split requests never outnumber it either.
+static bool RunRefinePass(SDL_GPUCommandBuffer *cmdBuf,
+                          const SDL_GPUStorageBufferReadWriteBinding *bindings,
+                          SDL_GPUComputePipeline *pipeline,
+                          SDL_GPUBuffer *indirectArgs) {
+  SDL_GPUComputePass *pass =
+      SDL_BeginGPUComputePass(cmdBuf, NULL, 0, bindings, SIM_BINDING_COUNT);
+  if (pass == NULL) {
+    SDL_Log("SDL_BeginGPUComputePass (refine) failed: %s", SDL_GetError());
+    return false;
+  }
+  SDL_BindGPUComputePipeline(pass, pipeline);
+  SDL_DispatchGPUComputeIndirect(pass, indirectArgs,
+                                 POOL_FIXED_DISPATCH_ARGS_OFFSET);
+  SDL_EndGPUComputePass(pass);
+  return true;
+}
+
+bool ParticleRefiner_Merge(const ParticleRefiner *refiner,
+                           SDL_GPUCommandBuffer *cmdBuf,
+                           const SDL_GPUStorageBufferReadWriteBinding *bindings,
+                           SDL_GPUBuffer *indirectArgs) {
+  return RunRefinePass(cmdBuf, bindings, refiner->proposePipeline,
+                       indirectArgs) &&
+         RunRefinePass(cmdBuf, bindings, refiner->mergePipeline, indirectArgs);
+}
+
+bool ParticleRefiner_Split(const ParticleRefiner *refiner,
+                           SDL_GPUCommandBuffer *cmdBuf,
+                           const SDL_GPUStorageBufferReadWriteBinding *bindings,
+                           SDL_GPUBuffer *indirectArgs) {
+  return RunRefinePass(cmdBuf, bindings, refiner->splitPipeline, indirectArgs);
+}
@@ -1,6 +1,16 @@
 #include "render.h"
 
 #include "shader_utils.h"
+#include "sim_layout.h"
+
+// Mirrors DrawParams in particles.slang, pushed at vertex uniform slot 0.
+typedef struct DrawUniforms {
+  Uint32 capacity;
+  // Index of the first alive list entry in the list buffer.
+  Uint32 aliveBase;
+  Uint32 pad0;
+  Uint32 pad1;
+} DrawUniforms;
 
 bool Render_Init(RenderState *state, SDL_GPUDevice *device,
                  SDL_GPUShaderFormat shaderFormat, const char *vertexShaderPath,
@@ -19,9 +29,10 @@ bool Render_Init(RenderState *state, SDL_GPUDevice *device,
       .stage = SDL_GPU_SHADERSTAGE_VERTEX,
       .num_samplers = 0,
       .num_storage_textures = 0,
-      // Bindings 1..6 are used for storage buffers, so expose 7 slots.
-      .num_storage_buffers = 7,
-      .num_uniform_buffers = 0};
+      // Particle planes and pool lists at their compute slots, which are
+      // the first two.
+      .num_storage_buffers = SIM_BINDING_POOL_LISTS + 1,
+      .num_uniform_buffers = 1};
 
   SDL_GPUShader *vertexShader =
       SDL_CreateGPUShader(device, &vertShaderCreateInfo);
@@ -136,21 +147,10 @@ void Render_Destroy(RenderState *state, SDL_GPUDevice *device) {
   }
 }
 
-bool Render_Draw(RenderState *state, SDL_GPUCommandBuffer *cmdBuf,
-                 SDL_Window *window, SDL_GPUBuffer *xCurr, SDL_GPUBuffer *yCurr,
-                 int numParticles) {
-  SDL_GPUTexture *swapchainTexture;
-  if (!SDL_WaitAndAcquireGPUSwapchainTexture(cmdBuf, window, &swapchainTexture,
-                                             NULL, NULL)) {
-    SDL_Log("SDL_WaitAndAcquireGPUSwapchainTexture: %s", SDL_GetError());
-    return false;
-  }
-
-  if (swapchainTexture == NULL) {
-    return true;
-  }
-
-  SDL_GPUColorTargetInfo targetInfo = {.texture = swapchainTexture,
+bool Render_DrawToTexture(RenderState *state, SDL_GPUCommandBuffer *cmdBuf,
+                          SDL_GPUTexture *target, Uint32 width, Uint32 height,
+                          const RenderParticles *particles) {
+  SDL_GPUColorTargetInfo targetInfo = {.texture = target,
                                        .cycle = true,
                                        .load_op = SDL_GPU_LOADOP_CLEAR,
                                        .store_op = SDL_GPU_STOREOP_STORE,
@@ -163,25 +163,72 @@ bool Render_Draw(RenderState *state, SDL_GPUCommandBuffer *cmdBuf,
     return false;
   }
 
-  int viewportWidth = 0;
-  int viewportHeight = 0;
-  SDL_GetWindowSizeInPixels(window, &viewportWidth, &viewportHeight);
   SDL_GPUViewport viewport = {.x = 0.0f,
                               .y = 0.0f,
-                              .w = (float)SDL_max(viewportWidth, 1),
-                              .h = (float)SDL_max(viewportHeight, 1),
+                              .w = (float)SDL_max(width, 1u),
+                              .h = (float)SDL_max(height, 1u),
                               .min_depth = 0.0f,
                               .max_depth = 1.0f};
   SDL_SetGPUViewport(renderPass, &viewport);
 
   SDL_BindGPUGraphicsPipeline(renderPass, state->pipeline);
 
-  SDL_GPUBuffer *buffers[] = {xCurr, yCurr};
-  // Vertex shader expects x/y at storage slots 0 and 1.
-  SDL_BindGPUVertexStorageBuffers(renderPass, 0, buffers, 2);
+  // Same slots as in the compute passes.
+  SDL_GPUBuffer *buffers[] = {particles->attributes, particles->lists};
+  SDL_BindGPUVertexStorageBuffers(renderPass, SIM_BINDING_PARTICLES, buffers,
+                                  SDL_arraysize(buffers));
+  DrawUniforms uniforms = {
+      .capacity = particles->capacity,
+      .aliveBase = particles->alivePlane * particles->capacity};
+  SDL_PushGPUVertexUniformData(cmdBuf, 0, &uniforms, sizeof(uniforms));
 
-  SDL_DrawGPUPrimitives(renderPass, (Uint32)numParticles, 1, 0, 0);
+  // Vertex count is the live particle count written by the pool on the GPU.
+  SDL_DrawGPUPrimitivesIndirect(renderPass, particles->indirectArgs,
+                                particles->drawArgsOffset, 1);
 
   SDL_EndGPURenderPass(renderPass);
   return true;
 }
+
+bool Render_Draw(RenderState *state, SDL_GPUCommandBuffer *cmdBuf,
+                 SDL_Window *window, const RenderParticles *particles) {
+  SDL_GPUTexture *swapchainTexture;
+  Uint32 width = 0;
+  Uint32 height = 0;
+  if (!SDL_WaitAndAcquireGPUSwapchainTexture(cmdBuf, window, &swapchainTexture,
+                                             &width, &height)) {
+    SDL_Log("SDL_WaitAndAcquireGPUSwapchainTexture: %s", SDL_GetError());
+    return false;
+  }
+
+  if (swapchainTexture == NULL) {
+    return true;
+  }
+
+  return Render_DrawToTexture(state, cmdBuf, swapchainTexture, width, height,
+                              particles);
+}
+
+void Render_PreviewTexture(SDL_GPUCommandBuffer *cmdBuf, SDL_Window *window,
+                           SDL_GPUTexture *source, Uint32 width,
+                           Uint32 height) {
+  // Non-waiting acquire: if the swapchain isn't ready we simply skip the
+  // preview rather than stall on vsync.
+  SDL_GPUTexture *swapchainTexture = NULL;
+  Uint32 swapWidth = 0;
+  Uint32 swapHeight = 0;
+  if (!SDL_AcquireGPUSwapchainTexture(cmdBuf, window, &swapchainTexture,
+                                      &swapWidth, &swapHeight) ||
+      swapchainTexture == NULL) {
+    return;
+  }
+
+  SDL_GPUBlitInfo blitInfo = {
+      .source = {.texture = source, .w = width, .h = height},
+      .destination = {.texture = swapchainTexture,
+                      .w = swapWidth,
+                      .h = swapHeight},
+      .load_op = SDL_GPU_LOADOP_DONT_CARE,
+      .filter = SDL_GPU_FILTER_LINEAR};
+  SDL_BlitGPUTexture(cmdBuf, &blitInfo);
+}
@@ -47,3 +47,41 @@ bool LoadShaderFile(const char *path, Uint8 **outBuffer, size_t *outSize) {
   *outSize = (size_t)length;
   return true;
 }
+
+SDL_GPUComputePipeline *CreateComputePipelineFromFile(
+    SDL_GPUDevice *device, SDL_GPUShaderFormat shaderFormat, const char *path,
+    const char *entrypoint, Uint32 numReadWriteStorageBuffers,
+    Uint32 numUniformBuffers, Uint32 threadCountX) {
+  Uint8 *code = NULL;
+  size_t size = 0;
+  if (!LoadShaderFile(path, &code, &size)) {
+    return NULL;
+  }
+
+  SDL_GPUComputePipelineCreateInfo createInfo = {
+      .code_size = size,
+      .code = code,
+      .entrypoint = entrypoint,
+      .format = shaderFormat,
+      .num_readwrite_storage_buffers = numReadWriteStorageBuffers,
+      .num_uniform_buffers = numUniformBuffers,
+      .threadcount_x = threadCountX,
+      .threadcount_y = 1,
+      .threadcount_z = 1};
+
+  SDL_GPUComputePipeline *pipeline =
+      SDL_CreateGPUComputePipeline(device, &createInfo);
+  SDL_free(code);
+  if (pipeline == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't create compute pipeline %s: %s", path,
+                 SDL_GetError());
+  }
+  return pipeline;
+}
+
+void BuildShaderPath(char *out, size_t outSize, const char *stage,
+                     SDL_GPUShaderFormat shaderFormat) {
+  SDL_snprintf(out, outSize, "assets/particles.%s.%s", stage,
+               shaderFormat == SDL_GPU_SHADERFORMAT_MSL ? "msl" : "spv");
+}
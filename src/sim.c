@@ -0,0 +1,772 @@
+#include "sim.h"
+
+#include "shader_utils.h"
+
+// Buffers owned by the sim rather than the pool or grid.
+static const SimBinding kOwnedBindings[] = {
+    SIM_BINDING_PARTICLES,
+    SIM_BINDING_SCENE_ID,
+    SIM_BINDING_SCENE_PARAMS,
+};
+
+typedef struct SimUpload {
+  SDL_GPUBuffer *buffer;
+  // Destination byte offset, for uploads into one plane of a buffer.
+  Uint32 offset;
+  const void *data;
+  // Bytes copied from data; the rest of size is zero-filled.
+  Uint32 dataSize;
+  Uint32 size;
+} SimUpload;
+
+// Copies every upload through one staging buffer.
+static bool UploadBuffers(SDL_GPUDevice *device, const SimUpload *uploads,
+                          size_t numUploads) {
+  Uint32 stagingSize = 0;
+  for (size_t i = 0; i < numUploads; i++) {
+    stagingSize += uploads[i].size;
+  }
+
+  SDL_GPUTransferBuffer *staging = SDL_CreateGPUTransferBuffer(
+      device, &(SDL_GPUTransferBufferCreateInfo){
+                  .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+                  .size = stagingSize});
+  if (staging == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't create transfer buffer: %s", SDL_GetError());
+    return false;
+  }
+
+  Uint8 *mapped = SDL_MapGPUTransferBuffer(device, staging, false);
+  if (mapped == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't map transfer buffer: %s", SDL_GetError());
+    SDL_ReleaseGPUTransferBuffer(device, staging);
+    return false;
+  }
+  Uint32 offset = 0;
+  for (size_t i = 0; i < numUploads; i++) {
+    Uint32 dataSize = uploads[i].data != NULL ? uploads[i].dataSize : 0;
+    if (dataSize > 0) {
+      SDL_memcpy(mapped + offset, uploads[i].data, dataSize);
+    }
+    SDL_memset(mapped + offset + dataSize, 0, uploads[i].size - dataSize);
+    offset += uploads[i].size;
+  }
+  SDL_UnmapGPUTransferBuffer(device, staging);
+
+  SDL_GPUCommandBuffer *cmdBuf = SDL_AcquireGPUCommandBuffer(device);
+  if (cmdBuf == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't acquire command buffer for upload: %s",
+                 SDL_GetError());
+    SDL_ReleaseGPUTransferBuffer(device, staging);
+    return false;
+  }
+  SDL_GPUCopyPass *copyPass = SDL_BeginGPUCopyPass(cmdBuf);
+  offset = 0;
+  for (size_t i = 0; i < numUploads; i++) {
+    SDL_GPUTransferBufferLocation src = {.transfer_buffer = staging,
+                                         .offset = offset};
+    SDL_GPUBufferRegion dst = {.buffer = uploads[i].buffer,
+                               .offset = uploads[i].offset,
+                               .size = uploads[i].size};
+    SDL_UploadToGPUBuffer(copyPass, &src, &dst, false);
+    offset += uploads[i].size;
+  }
+  SDL_EndGPUCopyPass(copyPass);
+  SDL_SubmitGPUCommandBuffer(cmdBuf);
+
+  SDL_ReleaseGPUTransferBuffer(device, staging);
+  return true;
+}
+
+// Steps per benchmark submission; enough to amortize the submit and to let
+// neighbour lists skip a few rebuilds, as they would in a run.
+#define KERNEL_BENCH_STEPS 8
+// Timed submissions per candidate after one warm-up; the fastest counts.
+#define KERNEL_BENCH_ROUNDS 3
+// Buffers a step writes and later steps read, see SaveState.
+#define SIM_SAVED_BUFFER_COUNT 5
+
+// Records the density or force pass of a variant. Global variants run one
+// thread per live particle; tiled ones run one workgroup per occupied grid
+// cell.
+static void DispatchInteraction(const Sim *sim, SDL_GPUComputePass *pass,
+                                const KernelVariant *variant) {
+  // Group counts come from the live count the pool wrote last step, or the
+  // occupied cells the grid scan counted.
+  SDL_DispatchGPUComputeIndirect(pass, sim->pool.indirectBuffer,
+                                 variant->neighbors == NEIGHBOR_MODE_TILED
+                                     ? POOL_GRID_TILED_ARGS_OFFSET
+                                     : POOL_DISPATCH_ARGS_OFFSET);
+}
+
+// The uploaded state, kept while benchmark steps run on the real buffers.
+// The grid isn't kept: the saved counters still mark it dirty, so the first
+// step after a restore rebuilds it.
+typedef struct SimSavedState {
+  SDL_GPUBuffer *copies[SIM_SAVED_BUFFER_COUNT];
+  ParticlePool pool;
+} SimSavedState;
+
+static void GetSavedBuffers(const Sim *sim,
+                            SDL_GPUBuffer *buffers[SIM_SAVED_BUFFER_COUNT],
+                            Uint32 sizes[SIM_SAVED_BUFFER_COUNT]) {
+  const Uint32 arraySize = (Uint32)(sizeof(Uint32) * sim->capacity);
+  buffers[0] = sim->buffers[SIM_BINDING_PARTICLES];
+  sizes[0] = arraySize * SIM_PLANE_COUNT;
+  buffers[1] = sim->buffers[SIM_BINDING_SCENE_ID];
+  sizes[1] = arraySize;
+  buffers[2] = sim->pool.listBuffer;
+  sizes[2] = arraySize * POOL_LIST_COUNT;
+  buffers[3] = sim->pool.counterBuffer;
+  sizes[3] = sizeof(Uint32) * POOL_COUNTER_COUNT;
+  buffers[4] = sim->pool.indirectBuffer;
+  sizes[4] = POOL_INDIRECT_ARGS_SIZE;
+}
+
+// Copies whole buffers in one submission. Later submissions see the copies.
+static bool CopyBuffers(SDL_GPUDevice *device, SDL_GPUBuffer *const *src,
+                        SDL_GPUBuffer *const *dst, const Uint32 *sizes,
+                        int count) {
+  SDL_GPUCommandBuffer *cmdBuf = SDL_AcquireGPUCommandBuffer(device);
+  if (cmdBuf == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't acquire command buffer for state copy: %s",
+                 SDL_GetError());
+    return false;
+  }
+  SDL_GPUCopyPass *copyPass = SDL_BeginGPUCopyPass(cmdBuf);
+  for (int i = 0; i < count; i++) {
+    SDL_CopyGPUBufferToBuffer(
+        copyPass, &(SDL_GPUBufferLocation){.buffer = src[i], .offset = 0},
+        &(SDL_GPUBufferLocation){.buffer = dst[i], .offset = 0}, sizes[i],
+        false);
+  }
+  SDL_EndGPUCopyPass(copyPass);
+  SDL_SubmitGPUCommandBuffer(cmdBuf);
+  return true;
+}
+
+static void ReleaseSavedState(SimSavedState *saved, SDL_GPUDevice *device) {
+  for (int i = 0; i < SIM_SAVED_BUFFER_COUNT; i++) {
+    if (saved->copies[i] != NULL) {
+      SDL_ReleaseGPUBuffer(device, saved->copies[i]);
+      saved->copies[i] = NULL;
+    }
+  }
+}
+
+static bool SaveState(const Sim *sim, SDL_GPUDevice *device,
+                      SimSavedState *saved) {
+  SDL_zerop(saved);
+  SDL_GPUBuffer *buffers[SIM_SAVED_BUFFER_COUNT];
+  Uint32 sizes[SIM_SAVED_BUFFER_COUNT];
+  GetSavedBuffers(sim, buffers, sizes);
+  for (int i = 0; i < SIM_SAVED_BUFFER_COUNT; i++) {
+    saved->copies[i] = SDL_CreateGPUBuffer(
+        device,
+        &(SDL_GPUBufferCreateInfo){
+            .usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ,
+            .size = sizes[i]});
+    if (saved->copies[i] == NULL) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Couldn't create benchmark state copy: %s", SDL_GetError());
+      ReleaseSavedState(saved, device);
+      return false;
+    }
+  }
+  saved->pool = sim->pool;
+  if (!CopyBuffers(device, buffers, saved->copies, sizes,
+                   SIM_SAVED_BUFFER_COUNT)) {
+    ReleaseSavedState(saved, device);
+    return false;
+  }
+  return true;
+}
+
+// Puts the buffers and the pool's host state (alive plane, frame, spawn
+// accumulators) back as SaveState found them.
+static bool RestoreState(Sim *sim, SDL_GPUDevice *device,
+                         const SimSavedState *saved) {
+  sim->pool = saved->pool;
+  SDL_GPUBuffer *buffers[SIM_SAVED_BUFFER_COUNT];
+  Uint32 sizes[SIM_SAVED_BUFFER_COUNT];
+  GetSavedBuffers(sim, buffers, sizes);
+  return CopyBuffers(device, saved->copies, buffers, sizes,
+                     SIM_SAVED_BUFFER_COUNT);
+}
+
+// Times whole steps with the kernels currently in sim->kernels: grid build
+// and list upkeep, density, force, refinement and integrate. Neighbour modes
+// shift cost between the interaction passes and the build, so only the
+// whole step compares them fairly. Steps move the particles; the caller
+// restores the state afterwards.
+static bool TimeSteps(Sim *sim, SDL_GPUDevice *device, Uint64 *outNs) {
+  Uint64 best = SDL_MAX_UINT64;
+  for (int round = 0; round <= KERNEL_BENCH_ROUNDS; round++) {
+    SDL_GPUCommandBuffer *cmdBuf = SDL_AcquireGPUCommandBuffer(device);
+    if (cmdBuf == NULL) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Couldn't acquire command buffer for benchmark: %s",
+                   SDL_GetError());
+      return false;
+    }
+    for (int i = 0; i < KERNEL_BENCH_STEPS; i++) {
+      if (!Sim_Step(sim, cmdBuf)) {
+        SDL_CancelGPUCommandBuffer(cmdBuf);
+        return false;
+      }
+    }
+
+    const Uint64 start = SDL_GetTicksNS();
+    SDL_GPUFence *fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdBuf);
+    if (fence == NULL) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Couldn't submit benchmark: %s", SDL_GetError());
+      return false;
+    }
+    SDL_WaitForGPUFences(device, true, &fence, 1);
+    SDL_ReleaseGPUFence(device, fence);
+    const Uint64 elapsed = SDL_GetTicksNS() - start;
+    // Round 0 warms up pipeline caches and clocks.
+    if (round > 0 && elapsed < best) {
+      best = elapsed;
+    }
+  }
+  *outNs = best / KERNEL_BENCH_STEPS;
+  return true;
+}
+
+// (Re)creates the grid, with or without neighbour lists; lists change the
+// cell size, skin and storage, so list candidates get a grid of their own.
+static bool InitGrid(Sim *sim, SDL_GPUDevice *device,
+                     SDL_GPUShaderFormat shaderFormat,
+                     const KernelConfig *config, bool lists,
+                     float maxSmoothingRadius, float maxNumberDensity) {
+  KernelConfig gridConfig = *config;
+  if (lists) {
+    gridConfig.neighbors = NEIGHBOR_MODE_LIST;
+  }
+  NeighborGrid_Destroy(&sim->grid, device);
+  return NeighborGrid_Init(&sim->grid, device, shaderFormat, sim->capacity,
+                           sim->numScenes, &sim->bounds, maxSmoothingRadius,
+                           maxNumberDensity, &gridConfig);
+}
+
+// Creates the grid, loads every variant the config allows and keeps the one
+// with the fastest step (see TimeSteps), leaving the grid set up for it. The
+// smoothing kernel and boundary mode are fixed by the config; group size and
+// neighbour mode are open unless pinned, precision only with
+// KERNEL_PRECISION_AUTO.
+static bool SelectKernels(Sim *sim, SDL_GPUDevice *device,
+                          SDL_GPUShaderFormat shaderFormat,
+                          const KernelConfig *config, Uint32 count,
+                          float maxSmoothingRadius, float maxNumberDensity) {
+  // Lists come last, so the grid is only rebuilt for them once.
+  bool gridLists = config->neighbors == NEIGHBOR_MODE_LIST;
+  if (!InitGrid(sim, device, shaderFormat, config, gridLists,
+                maxSmoothingRadius, maxNumberDensity)) {
+    return false;
+  }
+
+  // Candidate (neighbour mode, precision, group size) triples, global and
+  // fp32 first.
+  struct {
+    NeighborMode neighbors;
+    KernelPrecision precision;
+    Uint32 groupSize;
+  } candidates[NEIGHBOR_MODE_AUTO * 2 * KERNEL_NUM_GROUP_SIZES];
+  int numCandidates = 0;
+  // The grid may have fallen back to sparse, see GRID_MAX_DENSE_CELLS.
+  const bool sparse = sim->grid.layout == GRID_LAYOUT_SPARSE;
+  if (sparse && config->neighbors == NEIGHBOR_MODE_TILED) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Tiled neighbour mode needs the dense grid");
+    return false;
+  }
+  for (int n = NEIGHBOR_MODE_GLOBAL; n < NEIGHBOR_MODE_AUTO; n++) {
+    if (config->neighbors != NEIGHBOR_MODE_AUTO &&
+        config->neighbors != (NeighborMode)n) {
+      continue;
+    }
+    // Tiled dispatches one workgroup per dense cell.
+    if (sparse && n == NEIGHBOR_MODE_TILED) {
+      continue;
+    }
+    for (int p = KERNEL_PRECISION_FP32; p <= KERNEL_PRECISION_FP16; p++) {
+      if (config->precision != KERNEL_PRECISION_AUTO &&
+          config->precision != (KernelPrecision)p) {
+        continue;
+      }
+      for (int g = 0; g < KERNEL_NUM_GROUP_SIZES; g++) {
+        if (config->groupSize == 0 ||
+            config->groupSize == kKernelGroupSizes[g]) {
+          candidates[numCandidates].neighbors = (NeighborMode)n;
+          candidates[numCandidates].precision = (KernelPrecision)p;
+          candidates[numCandidates].groupSize = kKernelGroupSizes[g];
+          numCandidates++;
+        }
+      }
+    }
+  }
+  if (numCandidates == 0) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "No kernel variant with workgroup size %u",
+                 config->groupSize);
+    return false;
+  }
+
+  // Without particles there is nothing to time; take the first that loads.
+  const bool benchmark = numCandidates > 1 && count > 0;
+  SimSavedState saved;
+  if (benchmark && !SaveState(sim, device, &saved)) {
+    return false;
+  }
+  KernelVariant best = {0};
+  Uint64 bestNs = SDL_MAX_UINT64;
+  bool ok = true;
+  for (int c = 0; c < numCandidates && ok; c++) {
+    const bool lists = candidates[c].neighbors == NEIGHBOR_MODE_LIST;
+    if (lists != gridLists) {
+      if (!InitGrid(sim, device, shaderFormat, config, lists,
+                    maxSmoothingRadius, maxNumberDensity)) {
+        // Only AUTO gets here, and lists are the last candidates.
+        SDL_Log("Skipping neighbour lists");
+        ok = InitGrid(sim, device, shaderFormat, config, gridLists,
+                      maxSmoothingRadius, maxNumberDensity);
+        break;
+      }
+      gridLists = lists;
+    }
+
+    char name[64];
+    KernelVariants_Describe(name, sizeof(name), config->smoothing,
+                            config->boundary, sim->grid.layout,
+                            candidates[c].precision, candidates[c].groupSize);
+    const char *neighbors =
+        KernelVariants_NeighborsName(candidates[c].neighbors);
+    KernelVariant candidate;
+    // Storage buffers bound at slots 0..SIM_BINDING_COUNT-1, pool uniforms in
+    // slot 0 and grid uniforms in slot 1.
+    if (!KernelVariant_Load(&candidate, device, shaderFormat, config->smoothing,
+                            config->boundary, sim->grid.layout,
+                            candidates[c].precision, candidates[c].groupSize,
+                            candidates[c].neighbors, SIM_BINDING_COUNT, 2)) {
+      // Some drivers reject fp16 outright, and builds without the full
+      // variant matrix lack some; the other candidates may still load.
+      SDL_Log("Skipping kernel variant %s (%s): %s", name, neighbors,
+              SDL_GetError());
+      continue;
+    }
+
+    Uint64 ns = 0;
+    if (benchmark) {
+      sim->kernels = candidate;
+      sim->pool.dispatchGroupSize = candidate.groupSize;
+      ok = TimeSteps(sim, device, &ns) && RestoreState(sim, device, &saved);
+      sim->kernels = (KernelVariant){0};
+      if (ok) {
+        SDL_Log("Kernel variant %s (%s): %.3f ms per step", name, neighbors,
+                (double)ns / 1e6);
+      }
+    }
+    if (ok && (best.density == NULL || ns < bestNs)) {
+      KernelVariant_Destroy(&best, device);
+      best = candidate;
+      bestNs = ns;
+    } else {
+      KernelVariant_Destroy(&candidate, device);
+    }
+    if (!benchmark) {
+      break;
+    }
+  }
+  if (benchmark) {
+    ReleaseSavedState(&saved, device);
+  }
+
+  if (ok && best.density == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't load any simulation kernel variant");
+    ok = false;
+  }
+  // The last candidates may have left the grid set up for the other mode.
+  const bool bestLists = best.neighbors == NEIGHBOR_MODE_LIST;
+  if (ok && bestLists != gridLists) {
+    ok = InitGrid(sim, device, shaderFormat, config, bestLists,
+                  maxSmoothingRadius, maxNumberDensity);
+  }
+  if (!ok) {
+    KernelVariant_Destroy(&best, device);
+    return false;
+  }
+  sim->kernels = best;
+
+  char name[64];
+  KernelVariants_Describe(name, sizeof(name), sim->kernels.smoothing,
+                          sim->kernels.boundary, sim->kernels.layout,
+                          sim->kernels.precision, sim->kernels.groupSize);
+  SDL_Log("Using kernel variant %s (%s)", name,
+          KernelVariants_NeighborsName(sim->kernels.neighbors));
+  // Every candidate group size is at least SIM_THREADGROUP_SIZE, so the
+  // initial arguments only over-dispatch until the first finalize.
+  sim->pool.dispatchGroupSize = sim->kernels.groupSize;
+  return true;
+}
+
+// Union of the scenes' domains. Every domain needs some extent, and
+// periodic ones must all be the same box, since the grid wraps by its size.
+static bool SceneBounds(const SimInitialState *initial, BoundaryMode boundary,
+                        GridBounds *out) {
+  for (Uint32 i = 0; i < initial->numScenes; i++) {
+    const SceneParams *scene = &initial->scenes[i];
+    if (!(scene->domainMaxX > scene->domainMinX &&
+          scene->domainMaxY > scene->domainMinY)) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Scene %u has an empty domain (%g, %g) to (%g, %g)", i,
+                   (double)scene->domainMinX, (double)scene->domainMinY,
+                   (double)scene->domainMaxX, (double)scene->domainMaxY);
+      return false;
+    }
+    const GridBounds domain = {scene->domainMinX, scene->domainMinY,
+                               scene->domainMaxX, scene->domainMaxY};
+    if (i == 0) {
+      *out = domain;
+      continue;
+    }
+    if (boundary == BOUNDARY_PERIODIC &&
+        (domain.minX != out->minX || domain.minY != out->minY ||
+         domain.maxX != out->maxX || domain.maxY != out->maxY)) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Periodic boundaries need every scene in the same domain; "
+                   "scene %u differs from scene 0",
+                   i);
+      return false;
+    }
+    out->minX = SDL_min(out->minX, domain.minX);
+    out->minY = SDL_min(out->minY, domain.minY);
+    out->maxX = SDL_max(out->maxX, domain.maxX);
+    out->maxY = SDL_max(out->maxY, domain.maxY);
+  }
+  return true;
+}
+
+bool Sim_Init(Sim *sim, SDL_GPUDevice *device,
+              SDL_GPUShaderFormat shaderFormat, Uint32 capacity,
+              const SimInitialState *initial,
+              const KernelConfig *kernelConfig) {
+  SDL_zerop(sim);
+  if (initial->count > capacity || initial->numScenes == 0) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Invalid initial sim state: %u particles, %u scenes, "
+                 "capacity %u",
+                 initial->count, initial->numScenes, capacity);
+    return false;
+  }
+  if (!SceneBounds(initial, kernelConfig->boundary, &sim->bounds)) {
+    return false;
+  }
+  sim->capacity = capacity;
+  sim->numScenes = initial->numScenes;
+
+  SDL_GPUBufferCreateInfo bufferCreateInfo = {
+      .usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ |
+               SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ |
+               SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE};
+  for (size_t i = 0; i < SDL_arraysize(kOwnedBindings); i++) {
+    SimBinding binding = kOwnedBindings[i];
+    switch (binding) {
+    case SIM_BINDING_PARTICLES:
+      bufferCreateInfo.size =
+          (Uint32)(sizeof(float) * capacity * SIM_PLANE_COUNT);
+      break;
+    case SIM_BINDING_SCENE_PARAMS:
+      bufferCreateInfo.size =
+          (Uint32)(sizeof(SceneParams) * initial->numScenes);
+      break;
+    default:
+      bufferCreateInfo.size = (Uint32)(sizeof(Uint32) * capacity);
+      break;
+    }
+    sim->buffers[binding] = SDL_CreateGPUBuffer(device, &bufferCreateInfo);
+    if (sim->buffers[binding] == NULL) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Couldn't create particle buffers: %s", SDL_GetError());
+      Sim_Destroy(sim, device);
+      return false;
+    }
+  }
+
+  // Initial particles go in the low slots; the tail is zero-filled.
+  const Uint32 liveSize = (Uint32)(sizeof(float) * initial->count);
+  const Uint32 arraySize = (Uint32)(sizeof(float) * capacity);
+  const Uint32 sceneTableSize =
+      (Uint32)(sizeof(SceneParams) * initial->numScenes);
+  SDL_GPUBuffer *particles = sim->buffers[SIM_BINDING_PARTICLES];
+  const SimUpload uploads[] = {
+      {particles, SIM_PLANE_X_CURR * arraySize, initial->xCurr, liveSize,
+       arraySize},
+      {particles, SIM_PLANE_Y_CURR * arraySize, initial->yCurr, liveSize,
+       arraySize},
+      {particles, SIM_PLANE_X_PREV * arraySize, initial->xPrev, liveSize,
+       arraySize},
+      {particles, SIM_PLANE_Y_PREV * arraySize, initial->yPrev, liveSize,
+       arraySize},
+      {particles, SIM_PLANE_MASS * arraySize, initial->mass, liveSize,
+       arraySize},
+      {particles, SIM_PLANE_DENSITY * arraySize, NULL, 0, arraySize},
+      {sim->buffers[SIM_BINDING_SCENE_ID], 0, initial->sceneId, liveSize,
+       arraySize},
+      {sim->buffers[SIM_BINDING_SCENE_PARAMS], 0, initial->scenes,
+       sceneTableSize, sceneTableSize},
+  };
+  if (!UploadBuffers(device, uploads, SDL_arraysize(uploads))) {
+    Sim_Destroy(sim, device);
+    return false;
+  }
+
+  char emitPath[256];
+  char finalizePath[256];
+  BuildShaderPath(emitPath, sizeof(emitPath), "emit", shaderFormat);
+  BuildShaderPath(finalizePath, sizeof(finalizePath), "finalize", shaderFormat);
+  if (!ParticlePool_Init(&sim->pool, device, shaderFormat, emitPath,
+                         finalizePath, capacity, initial->count)) {
+    Sim_Destroy(sim, device);
+    return false;
+  }
+
+  // Sized for the widest support among scenes that compute density at all;
+  // in adaptive scenes that belongs to the heaviest merged particle. The
+  // densest packing belongs to the lightest particles: starting at unit mass,
+  // that is fully split ones in adaptive scenes.
+  float maxSmoothingRadius = 0.0f;
+  float maxNumberDensity = 0.0f;
+  for (Uint32 i = 0; i < initial->numScenes; i++) {
+    const SceneParams *scene = &initial->scenes[i];
+    if (scene->maxMass > 0.0f) {
+      sim->adaptive = true;
+    }
+    if (scene->stiffness > 0.0f) {
+      float radius = scene->smoothingRadius;
+      if (scene->maxMass > 0.0f) {
+        radius *= SDL_sqrtf(SDL_max(scene->maxMass, 1.0f));
+      }
+      maxSmoothingRadius = SDL_max(maxSmoothingRadius, radius);
+      float lightest = 1.0f;
+      if (scene->maxMass > 0.0f && scene->minMass > 0.0f) {
+        lightest = SDL_min(scene->minMass, 1.0f);
+      }
+      maxNumberDensity =
+          SDL_max(maxNumberDensity, scene->restDensity / lightest);
+    }
+  }
+  if (sim->adaptive &&
+      !ParticleRefiner_Init(&sim->refiner, device, shaderFormat)) {
+    Sim_Destroy(sim, device);
+    return false;
+  }
+
+  // Creates the grid for the chosen neighbour mode. Benchmarks steps on the
+  // uploaded state, so the buffers, pool and refiner must exist first.
+  if (!SelectKernels(sim, device, shaderFormat, kernelConfig, initial->count,
+                     maxSmoothingRadius, maxNumberDensity)) {
+    Sim_Destroy(sim, device);
+    return false;
+  }
+  return true;
+}
+
+void Sim_Destroy(Sim *sim, SDL_GPUDevice *device) {
+  if (sim == NULL || device == NULL) {
+    return;
+  }
+  ParticlePool_Destroy(&sim->pool, device);
+  NeighborGrid_Destroy(&sim->grid, device);
+  ParticleRefiner_Destroy(&sim->refiner, device);
+  for (int i = 0; i < SIM_BINDING_COUNT; i++) {
+    if (sim->buffers[i] != NULL) {
+      SDL_ReleaseGPUBuffer(device, sim->buffers[i]);
+      sim->buffers[i] = NULL;
+    }
+  }
+  KernelVariant_Destroy(&sim->kernels, device);
+}
+
+static void FillBindings(const Sim *sim,
+                         SDL_GPUStorageBufferReadWriteBinding *bindings) {
+  for (int i = 0; i < SIM_BINDING_COUNT; i++) {
+    bindings[i] = (SDL_GPUStorageBufferReadWriteBinding){
+        .buffer = sim->buffers[i], .cycle = false};
+  }
+  ParticlePool_FillBindings(&sim->pool, bindings);
+  NeighborGrid_FillBindings(&sim->grid, bindings);
+}
+
+// One pass per stage, so each sees the previous one's writes.
+static bool RunStage(const Sim *sim, SDL_GPUCommandBuffer *cmdBuf,
+                     const SDL_GPUStorageBufferReadWriteBinding *bindings,
+                     SDL_GPUComputePipeline *pipeline, bool interaction) {
+  SDL_GPUComputePass *computePass =
+      SDL_BeginGPUComputePass(cmdBuf, NULL, 0, bindings, SIM_BINDING_COUNT);
+  if (computePass == NULL) {
+    SDL_Log("SDL_BeginGPUComputePass failed: %s", SDL_GetError());
+    return false;
+  }
+  SDL_BindGPUComputePipeline(computePass, pipeline);
+  if (interaction) {
+    DispatchInteraction(sim, computePass, &sim->kernels);
+  } else {
+    // Group count comes from the live count the pool wrote last step.
+    SDL_DispatchGPUComputeIndirect(computePass, sim->pool.indirectBuffer,
+                                   POOL_DISPATCH_ARGS_OFFSET);
+  }
+  SDL_EndGPUComputePass(computePass);
+  return true;
+}
+
+bool Sim_Step(Sim *sim, SDL_GPUCommandBuffer *cmdBuf) {
+  ParticlePool *pool = &sim->pool;
+  ParticlePool_PushUniforms(pool, cmdBuf);
+  NeighborGrid_PushUniforms(&sim->grid, cmdBuf);
+
+  SDL_GPUStorageBufferReadWriteBinding rwBindings[SIM_BINDING_COUNT];
+  FillBindings(sim, rwBindings);
+
+  // Cell sort, SPH density, pressure kick and Verlet integration, for every
+  // scene at once. Adaptive scenes merge before integrating and split once
+  // emission has taken its slots.
+  return NeighborGrid_Build(&sim->grid, cmdBuf, rwBindings,
+                            pool->indirectBuffer) &&
+         RunStage(sim, cmdBuf, rwBindings, sim->kernels.density, true) &&
+         RunStage(sim, cmdBuf, rwBindings, sim->kernels.force, true) &&
+         (!sim->adaptive ||
+          ParticleRefiner_Merge(&sim->refiner, cmdBuf, rwBindings,
+                                pool->indirectBuffer)) &&
+         RunStage(sim, cmdBuf, rwBindings, sim->kernels.integrate, false) &&
+         ParticlePool_Emit(pool, cmdBuf, rwBindings) &&
+         (!sim->adaptive ||
+          ParticleRefiner_Split(&sim->refiner, cmdBuf, rwBindings,
+                                pool->indirectBuffer)) &&
+         ParticlePool_Finalize(pool, cmdBuf, rwBindings);
+}
+
+SDL_GPUBuffer *Sim_GetBuffer(const Sim *sim, SimBinding binding) {
+  SDL_GPUStorageBufferReadWriteBinding bindings[SIM_BINDING_COUNT];
+  FillBindings(sim, bindings);
+  return bindings[binding].buffer;
+}
+
+// Snapshot layout: counters, alive list, the particle planes in SimPlane order,
+// then the scene ids; every array is capacity-sized.
+Uint32 Sim_SnapshotSize(const Sim *sim) {
+  return (Uint32)(sizeof(Uint32) * POOL_COUNTER_COUNT +
+                  sizeof(Uint32) * sim->capacity * (1 + SIM_PLANE_COUNT + 1));
+}
+
+void Sim_RecordSnapshot(const Sim *sim, SDL_GPUCopyPass *copyPass,
+                        SDL_GPUTransferBuffer *transfer) {
+  const Uint32 arraySize = (Uint32)(sizeof(Uint32) * sim->capacity);
+  Uint32 offset = 0;
+
+  SDL_GPUBufferRegion counters = {.buffer = sim->pool.counterBuffer,
+                                  .offset = 0,
+                                  .size = sizeof(Uint32) * POOL_COUNTER_COUNT};
+  SDL_DownloadFromGPUBuffer(
+      copyPass, &counters,
+      &(SDL_GPUTransferBufferLocation){.transfer_buffer = transfer,
+                                       .offset = offset});
+  offset += counters.size;
+
+  const SDL_GPUBufferRegion regions[] = {
+      {.buffer = sim->pool.listBuffer,
+       .offset = arraySize * ParticlePool_GetAlivePlane(&sim->pool),
+       .size = arraySize},
+      // The planes are already laid out back to back.
+      {.buffer = sim->buffers[SIM_BINDING_PARTICLES],
+       .offset = 0,
+       .size = arraySize * SIM_PLANE_COUNT},
+      {.buffer = sim->buffers[SIM_BINDING_SCENE_ID],
+       .offset = 0,
+       .size = arraySize},
+  };
+  for (size_t i = 0; i < SDL_arraysize(regions); i++) {
+    SDL_DownloadFromGPUBuffer(
+        copyPass, &regions[i],
+        &(SDL_GPUTransferBufferLocation){.transfer_buffer = transfer,
+                                         .offset = offset});
+    offset += regions[i].size;
+  }
+}
+
+void Sim_ParseSnapshot(Uint32 capacity, const Uint8 *data, SimSnapshot *out) {
+  const Uint32 *counters = (const Uint32 *)data;
+  const Uint8 *arrays = data + sizeof(Uint32) * POOL_COUNTER_COUNT;
+  const size_t arraySize = sizeof(Uint32) * capacity;
+
+  out->aliveCount = SDL_min(counters[POOL_COUNTER_ALIVE], capacity);
+  out->listOverflow = counters[POOL_COUNTER_LIST_OVERFLOW];
+  out->alive = (const Uint32 *)arrays;
+  out->xCurr = (const float *)(arrays + 1 * arraySize);
+  out->yCurr = (const float *)(arrays + 2 * arraySize);
+  out->xPrev = (const float *)(arrays + 3 * arraySize);
+  out->yPrev = (const float *)(arrays + 4 * arraySize);
+  out->mass = (const float *)(arrays + 5 * arraySize);
+  out->density = (const float *)(arrays + 6 * arraySize);
+  out->sceneId = (const Uint32 *)(arrays + (1 + SIM_PLANE_COUNT) * arraySize);
+}
+
+Uint8 *Sim_DownloadSnapshot(const Sim *sim, SDL_GPUDevice *device,
+                            SimSnapshot *out) {
+  const Uint32 size = Sim_SnapshotSize(sim);
+  SDL_GPUTransferBuffer *transfer = SDL_CreateGPUTransferBuffer(
+      device, &(SDL_GPUTransferBufferCreateInfo){
+                  .usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD, .size = size});
+  if (transfer == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't create snapshot transfer buffer: %s",
+                 SDL_GetError());
+    return NULL;
+  }
+
+  SDL_GPUCommandBuffer *cmdBuf = SDL_AcquireGPUCommandBuffer(device);
+  if (cmdBuf == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't acquire command buffer for snapshot: %s",
+                 SDL_GetError());
+    SDL_ReleaseGPUTransferBuffer(device, transfer);
+    return NULL;
+  }
+  SDL_GPUCopyPass *copyPass = SDL_BeginGPUCopyPass(cmdBuf);
+  Sim_RecordSnapshot(sim, copyPass, transfer);
+  SDL_EndGPUCopyPass(copyPass);
+  SDL_GPUFence *fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdBuf);
+  if (fence == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't submit snapshot download: %s", SDL_GetError());
+    SDL_ReleaseGPUTransferBuffer(device, transfer);
+    return NULL;
+  }
+  SDL_WaitForGPUFences(device, true, &fence, 1);
+  SDL_ReleaseGPUFence(device, fence);
+
+  Uint8 *copy = (Uint8 *)SDL_malloc(size);
+  const Uint8 *mapped = SDL_MapGPUTransferBuffer(device, transfer, false);
+  if (copy == NULL || mapped == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't read back snapshot: %s", SDL_GetError());
+    if (mapped != NULL) {
+      SDL_UnmapGPUTransferBuffer(device, transfer);
+    }
+    SDL_free(copy);
+    SDL_ReleaseGPUTransferBuffer(device, transfer);
+    return NULL;
+  }
+  SDL_memcpy(copy, mapped, size);
+  SDL_UnmapGPUTransferBuffer(device, transfer);
+  SDL_ReleaseGPUTransferBuffer(device, transfer);
+
+  Sim_ParseSnapshot(sim->capacity, copy, out);
+  return copy;
+}
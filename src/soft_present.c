@@ -0,0 +1,170 @@
+#include "soft_present.h"
+
+// Snapshots between the GPU and the drawing worker, as for capture.
+#define SOFT_PRESENT_RING_SLOTS 3
+
+// Runs on the readback worker.
+static void DrawPresentedFrame(void *userdata, const Uint8 *data, Uint32 size,
+                               Uint64 frame) {
+  (void)size;
+  (void)frame;
+  SoftPresenter *presenter = (SoftPresenter *)userdata;
+
+  SimSnapshot snapshot;
+  Sim_ParseSnapshot(presenter->capacity, data, &snapshot);
+  SoftRenderer *soft = &presenter->soft;
+  if (!SoftRender_Draw(soft, snapshot.xCurr, snapshot.yCurr, snapshot.alive,
+                       snapshot.aliveCount)) {
+    return;
+  }
+
+  // Only the copy is locked, so presenting never waits for a whole draw.
+  SDL_LockMutex(presenter->lock);
+  SDL_memcpy(presenter->frame, soft->pixels,
+             sizeof(Uint32) * (size_t)soft->pitch * (size_t)soft->height);
+  presenter->frameReady = true;
+  SDL_UnlockMutex(presenter->lock);
+}
+
+bool SoftPresent_Init(SoftPresenter *presenter, SDL_GPUDevice *device,
+                      SDL_Window *window, const Sim *sim, int numThreads) {
+  SDL_zerop(presenter);
+  presenter->capacity = sim->capacity;
+
+  int width = 0;
+  int height = 0;
+  SDL_GetWindowSizeInPixels(window, &width, &height);
+  width = SDL_max(width, 1);
+  height = SDL_max(height, 1);
+
+  presenter->renderer = SDL_CreateRenderer(window, SDL_SOFTWARE_RENDERER);
+  if (presenter->renderer == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't create software renderer: %s", SDL_GetError());
+    return false;
+  }
+  // Bytes R, G, B, A in memory, like the SoftRenderer framebuffer. Scaled to
+  // the window when it is resized.
+  presenter->texture =
+      SDL_CreateTexture(presenter->renderer, SDL_PIXELFORMAT_RGBA32,
+                        SDL_TEXTUREACCESS_STREAMING, width, height);
+  if (presenter->texture == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't create presentation texture: %s", SDL_GetError());
+    SoftPresent_Destroy(presenter);
+    return false;
+  }
+
+  if (!SoftRender_Init(&presenter->soft, width, height, numThreads)) {
+    SoftPresent_Destroy(presenter);
+    return false;
+  }
+  presenter->lock = SDL_CreateMutex();
+  presenter->frame = (Uint32 *)SDL_malloc(sizeof(Uint32) *
+                                          (size_t)presenter->soft.pitch *
+                                          (size_t)height);
+  if (presenter->lock == NULL || presenter->frame == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't allocate presentation frame");
+    SoftPresent_Destroy(presenter);
+    return false;
+  }
+
+  if (!Readback_Init(&presenter->ring, device, Sim_SnapshotSize(sim),
+                     SOFT_PRESENT_RING_SLOTS, DrawPresentedFrame, presenter,
+                     "soft-present")) {
+    SoftPresent_Destroy(presenter);
+    return false;
+  }
+
+  SDL_Log("Presenting %dx%d frames through the software renderer", width,
+          height);
+  return true;
+}
+
+void SoftPresent_Destroy(SoftPresenter *presenter) {
+  if (presenter == NULL) {
+    return;
+  }
+  // Drains every in-flight snapshot through the worker, which still draws.
+  Readback_Destroy(&presenter->ring);
+  SoftRender_Destroy(&presenter->soft);
+  SDL_free(presenter->frame);
+  presenter->frame = NULL;
+  if (presenter->lock != NULL) {
+    SDL_DestroyMutex(presenter->lock);
+    presenter->lock = NULL;
+  }
+  if (presenter->texture != NULL) {
+    SDL_DestroyTexture(presenter->texture);
+    presenter->texture = NULL;
+  }
+  if (presenter->renderer != NULL) {
+    SDL_DestroyRenderer(presenter->renderer);
+    presenter->renderer = NULL;
+  }
+}
+
+// Uploads and shows the newest finished frame, if there is one. A failed
+// present only costs that frame.
+static void PresentLatest(SoftPresenter *presenter) {
+  SDL_LockMutex(presenter->lock);
+  const bool ready = presenter->frameReady;
+  bool ok = true;
+  if (ready) {
+    ok = SDL_UpdateTexture(presenter->texture, NULL, presenter->frame,
+                           (int)sizeof(Uint32) * presenter->soft.pitch);
+    presenter->frameReady = false;
+  }
+  SDL_UnlockMutex(presenter->lock);
+  if (!ready) {
+    return;
+  }
+  if (!ok || !SDL_RenderTexture(presenter->renderer, presenter->texture, NULL,
+                                NULL) ||
+      !SDL_RenderPresent(presenter->renderer)) {
+    SDL_Log("Software present failed: %s", SDL_GetError());
+  }
+}
+
+bool SoftPresent_Ready(SoftPresenter *presenter) {
+  // Acquire also hands finished downloads to the worker.
+  const bool ready = Readback_Acquire(&presenter->ring) != NULL;
+  PresentLatest(presenter);
+  return ready;
+}
+
+bool SoftPresent_Step(SoftPresenter *presenter, SDL_GPUDevice *device,
+                      const Sim *sim) {
+  const Uint64 step = presenter->steps++;
+  SDL_GPUTransferBuffer *transfer = Readback_Acquire(&presenter->ring);
+  if (transfer == NULL) {
+    // Caller skipped SoftPresent_Ready; this step just isn't shown.
+    return true;
+  }
+
+  // A command buffer of our own, so the frame's submit stays untouched.
+  SDL_GPUCommandBuffer *cmdBuf = SDL_AcquireGPUCommandBuffer(device);
+  if (cmdBuf == NULL) {
+    SDL_Log("SDL_AcquireGPUCommandBuffer (present) failed: %s",
+            SDL_GetError());
+    return false;
+  }
+  SDL_GPUCopyPass *copyPass = SDL_BeginGPUCopyPass(cmdBuf);
+  if (copyPass == NULL) {
+    SDL_Log("SDL_BeginGPUCopyPass (present) failed: %s", SDL_GetError());
+    SDL_CancelGPUCommandBuffer(cmdBuf);
+    return false;
+  }
+  Sim_RecordSnapshot(sim, copyPass, transfer);
+  SDL_EndGPUCopyPass(copyPass);
+
+  SDL_GPUFence *fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdBuf);
+  if (fence == NULL) {
+    SDL_Log("SDL_SubmitGPUCommandBufferAndAcquireFence failed: %s",
+            SDL_GetError());
+    return false;
+  }
+  Readback_Commit(&presenter->ring, fence, step);
+  return true;
+}
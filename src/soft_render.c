@@ -0,0 +1,447 @@
+#include "soft_render.h"
+
+#include <SDL3/SDL_intrin.h>
+#include <stdio.h>
+
+// Lanes per SIMD vector, in pixels and in floats.
+#define SOFT_RENDER_LANES 4
+#define SOFT_RENDER_MAX_THREADS 64
+
+// Pixel coordinates are clamped to this before converting to int; anything
+// that far out is culled anyway.
+#define SOFT_RENDER_COORD_LIMIT 8192.0f
+
+// Byte-wise saturating add, the scalar version of _mm_adds_epu8.
+static Uint32 AddSaturate(Uint32 a, Uint32 b) {
+  Uint32 out = 0;
+  for (int shift = 0; shift < 32; shift += 8) {
+    Uint32 sum = ((a >> shift) & 0xFF) + ((b >> shift) & 0xFF);
+    out |= (sum > 0xFF ? 0xFF : sum) << shift;
+  }
+  return out;
+}
+
+static void FillSpan(Uint32 *dst, int n, Uint32 value) {
+  int i = 0;
+#if defined(SDL_SSE2_INTRINSICS)
+  const __m128i v = _mm_set1_epi32((int)value);
+  for (; i + SOFT_RENDER_LANES <= n; i += SOFT_RENDER_LANES) {
+    _mm_storeu_si128((__m128i *)(dst + i), v);
+  }
+#elif defined(SDL_NEON_INTRINSICS)
+  const uint32x4_t v = vdupq_n_u32(value);
+  for (; i + SOFT_RENDER_LANES <= n; i += SOFT_RENDER_LANES) {
+    vst1q_u32(dst + i, v);
+  }
+#endif
+  for (; i < n; i++) {
+    dst[i] = value;
+  }
+}
+
+static void SplatSpan(Uint32 *dst, int n, Uint32 color) {
+  int i = 0;
+#if defined(SDL_SSE2_INTRINSICS)
+  const __m128i c = _mm_set1_epi32((int)color);
+  for (; i + SOFT_RENDER_LANES <= n; i += SOFT_RENDER_LANES) {
+    __m128i *p = (__m128i *)(dst + i);
+    _mm_storeu_si128(p, _mm_adds_epu8(_mm_loadu_si128(p), c));
+  }
+#elif defined(SDL_NEON_INTRINSICS)
+  const uint8x16_t c = vreinterpretq_u8_u32(vdupq_n_u32(color));
+  for (; i + SOFT_RENDER_LANES <= n; i += SOFT_RENDER_LANES) {
+    uint8x16_t v = vreinterpretq_u8_u32(vld1q_u32(dst + i));
+    vst1q_u32(dst + i, vreinterpretq_u32_u8(vqaddq_u8(v, c)));
+  }
+#endif
+  for (; i < n; i++) {
+    dst[i] = AddSaturate(dst[i], color);
+  }
+}
+
+// Copies a tile row out to the framebuffer. n is a multiple of the lane count
+// and dst is 16-byte aligned; the finished frame isn't read again by this
+// thread, so SSE2 bypasses the cache instead of evicting the tiles.
+static void StreamSpan(Uint32 *dst, const Uint32 *src, int n) {
+#if defined(SDL_SSE2_INTRINSICS)
+  for (int i = 0; i < n; i += SOFT_RENDER_LANES) {
+    _mm_stream_si128((__m128i *)(dst + i),
+                     _mm_load_si128((const __m128i *)(src + i)));
+  }
+#elif defined(SDL_NEON_INTRINSICS)
+  for (int i = 0; i < n; i += SOFT_RENDER_LANES) {
+    vst1q_u32(dst + i, vld1q_u32(src + i));
+  }
+#else
+  SDL_memcpy(dst, src, sizeof(Uint32) * (size_t)n);
+#endif
+}
+
+// Converts one lane group of NDC positions to the top-left pixel of each
+// point.
+static void TransformPoints(const SoftRenderer *r, const float *x,
+                            const float *y, int *outX, int *outY) {
+  const float scaleX = 0.5f * (float)r->width;
+  const float scaleY = -0.5f * (float)r->height;
+  const float offsetX = scaleX - 0.5f * (float)r->pointSize;
+  const float offsetY = -scaleY - 0.5f * (float)r->pointSize;
+  const float limit = SOFT_RENDER_COORD_LIMIT;
+#if defined(SDL_SSE2_INTRINSICS)
+  __m128 px = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x), _mm_set1_ps(scaleX)),
+                         _mm_set1_ps(offsetX));
+  __m128 py = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(y), _mm_set1_ps(scaleY)),
+                         _mm_set1_ps(offsetY));
+  px = _mm_min_ps(_mm_max_ps(px, _mm_set1_ps(-limit)), _mm_set1_ps(limit));
+  py = _mm_min_ps(_mm_max_ps(py, _mm_set1_ps(-limit)), _mm_set1_ps(limit));
+  // Floor: truncate, then step down where truncation rounded up (the compare
+  // mask is -1 in those lanes).
+  __m128i ix = _mm_cvttps_epi32(px);
+  __m128i iy = _mm_cvttps_epi32(py);
+  ix = _mm_add_epi32(
+      ix, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(ix), px)));
+  iy = _mm_add_epi32(
+      iy, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(iy), py)));
+  _mm_storeu_si128((__m128i *)outX, ix);
+  _mm_storeu_si128((__m128i *)outY, iy);
+#elif defined(SDL_NEON_INTRINSICS)
+  float32x4_t px = vmlaq_n_f32(vdupq_n_f32(offsetX), vld1q_f32(x), scaleX);
+  float32x4_t py = vmlaq_n_f32(vdupq_n_f32(offsetY), vld1q_f32(y), scaleY);
+  px = vminq_f32(vmaxq_f32(px, vdupq_n_f32(-limit)), vdupq_n_f32(limit));
+  py = vminq_f32(vmaxq_f32(py, vdupq_n_f32(-limit)), vdupq_n_f32(limit));
+  // Floor: truncate, then step down where truncation rounded up.
+  int32x4_t ix = vcvtq_s32_f32(px);
+  int32x4_t iy = vcvtq_s32_f32(py);
+  ix = vaddq_s32(ix, vreinterpretq_s32_u32(vcgtq_f32(vcvtq_f32_s32(ix), px)));
+  iy = vaddq_s32(iy, vreinterpretq_s32_u32(vcgtq_f32(vcvtq_f32_s32(iy), py)));
+  vst1q_s32(outX, ix);
+  vst1q_s32(outY, iy);
+#else
+  for (int i = 0; i < SOFT_RENDER_LANES; i++) {
+    const float px = SDL_clamp(x[i] * scaleX + offsetX, -limit, limit);
+    const float py = SDL_clamp(y[i] * scaleY + offsetY, -limit, limit);
+    outX[i] = (int)SDL_floorf(px);
+    outY[i] = (int)SDL_floorf(py);
+  }
+#endif
+}
+
+// Tile range a point covers, or false if it is entirely off screen.
+static bool PointTiles(const SoftRenderer *r, int x0, int y0, int *tx0,
+                       int *ty0, int *tx1, int *ty1) {
+  const int x1 = x0 + r->pointSize - 1;
+  const int y1 = y0 + r->pointSize - 1;
+  if (x1 < 0 || y1 < 0 || x0 >= r->width || y0 >= r->height) {
+    return false;
+  }
+  *tx0 = SDL_max(x0, 0) / SOFT_RENDER_TILE_SIZE;
+  *ty0 = SDL_max(y0, 0) / SOFT_RENDER_TILE_SIZE;
+  *tx1 = SDL_min(x1, r->width - 1) / SOFT_RENDER_TILE_SIZE;
+  *ty1 = SDL_min(y1, r->height - 1) / SOFT_RENDER_TILE_SIZE;
+  return true;
+}
+
+// Counting sort of point indices by tile. Points on a tile border are listed
+// in every tile they touch.
+static bool BinPoints(SoftRenderer *r, Uint32 count) {
+  const int numTiles = r->tilesX * r->tilesY;
+  SDL_memset(r->tileFill, 0, sizeof(Uint32) * (size_t)numTiles);
+  for (Uint32 i = 0; i < count; i++) {
+    int tx0, ty0, tx1, ty1;
+    if (!PointTiles(r, r->pointX[i], r->pointY[i], &tx0, &ty0, &tx1, &ty1)) {
+      continue;
+    }
+    for (int ty = ty0; ty <= ty1; ty++) {
+      for (int tx = tx0; tx <= tx1; tx++) {
+        r->tileFill[ty * r->tilesX + tx]++;
+      }
+    }
+  }
+
+  Uint32 total = 0;
+  for (int t = 0; t < numTiles; t++) {
+    r->tileStart[t] = total;
+    total += r->tileFill[t];
+    r->tileFill[t] = r->tileStart[t];
+  }
+  r->tileStart[numTiles] = total;
+
+  if (total > r->binnedCapacity) {
+    Uint32 *grown =
+        (Uint32 *)SDL_realloc(r->binned, sizeof(Uint32) * (size_t)total);
+    if (grown == NULL) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Couldn't allocate software render bins");
+      return false;
+    }
+    r->binned = grown;
+    r->binnedCapacity = total;
+  }
+
+  for (Uint32 i = 0; i < count; i++) {
+    int tx0, ty0, tx1, ty1;
+    if (!PointTiles(r, r->pointX[i], r->pointY[i], &tx0, &ty0, &tx1, &ty1)) {
+      continue;
+    }
+    for (int ty = ty0; ty <= ty1; ty++) {
+      for (int tx = tx0; tx <= tx1; tx++) {
+        r->binned[r->tileFill[ty * r->tilesX + tx]++] = i;
+      }
+    }
+  }
+  return true;
+}
+
+static void RenderTile(const SoftRenderer *r, Uint32 *tile, int t) {
+  const int ox = (t % r->tilesX) * SOFT_RENDER_TILE_SIZE;
+  const int oy = (t / r->tilesX) * SOFT_RENDER_TILE_SIZE;
+  const int tw = SDL_min(SOFT_RENDER_TILE_SIZE, r->width - ox);
+  const int th = SDL_min(SOFT_RENDER_TILE_SIZE, r->height - oy);
+
+  FillSpan(tile, SOFT_RENDER_TILE_SIZE * th, r->background);
+  for (Uint32 k = r->tileStart[t]; k < r->tileStart[t + 1]; k++) {
+    const Uint32 i = r->binned[k];
+    const int x0 = SDL_max(r->pointX[i] - ox, 0);
+    const int y0 = SDL_max(r->pointY[i] - oy, 0);
+    const int x1 = SDL_min(r->pointX[i] - ox + r->pointSize, tw);
+    const int y1 = SDL_min(r->pointY[i] - oy + r->pointSize, th);
+    for (int row = y0; row < y1; row++) {
+      SplatSpan(tile + row * SOFT_RENDER_TILE_SIZE + x0, x1 - x0, r->color);
+    }
+  }
+
+  // Rows are padded to the pitch, so the last tile column can be copied a
+  // whole vector at a time.
+  const int copyWidth =
+      (tw + SOFT_RENDER_LANES - 1) / SOFT_RENDER_LANES * SOFT_RENDER_LANES;
+  for (int row = 0; row < th; row++) {
+    StreamSpan(r->pixels + (size_t)(oy + row) * (size_t)r->pitch + ox,
+               tile + row * SOFT_RENDER_TILE_SIZE, copyWidth);
+  }
+#if defined(SDL_SSE2_INTRINSICS)
+  // Streaming stores are weakly ordered; publish them before the tile is
+  // reported done.
+  _mm_sfence();
+#endif
+}
+
+static void RenderTiles(SoftRenderer *r, Uint32 *tile) {
+  const int numTiles = r->tilesX * r->tilesY;
+  for (int t = SDL_AddAtomicInt(&r->nextTile, 1); t < numTiles;
+       t = SDL_AddAtomicInt(&r->nextTile, 1)) {
+    RenderTile(r, tile, t);
+  }
+}
+
+static int SoftRenderWorkerMain(void *data) {
+  SoftRenderWorker *worker = (SoftRenderWorker *)data;
+  SoftRenderer *r = worker->renderer;
+  Uint64 seen = 0;
+  for (;;) {
+    SDL_LockMutex(r->lock);
+    while (!r->quit && r->generation == seen) {
+      SDL_WaitCondition(r->wake, r->lock);
+    }
+    if (r->quit) {
+      SDL_UnlockMutex(r->lock);
+      return 0;
+    }
+    seen = r->generation;
+    SDL_UnlockMutex(r->lock);
+
+    RenderTiles(r, worker->tile);
+
+    SDL_LockMutex(r->lock);
+    if (--r->busy == 0) {
+      SDL_SignalCondition(r->done);
+    }
+    SDL_UnlockMutex(r->lock);
+  }
+}
+
+bool SoftRender_Init(SoftRenderer *renderer, int width, int height,
+                     int numThreads) {
+  SDL_zerop(renderer);
+  if (width <= 0 || height <= 0) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Invalid software render size %dx%d", width, height);
+    return false;
+  }
+  renderer->width = width;
+  renderer->height = height;
+  renderer->pitch =
+      (width + SOFT_RENDER_LANES - 1) / SOFT_RENDER_LANES * SOFT_RENDER_LANES;
+  renderer->background = 0xFF000000u;
+  renderer->color = 0xFFFFFFFFu;
+  renderer->pointSize = 4;
+  renderer->tilesX =
+      (width + SOFT_RENDER_TILE_SIZE - 1) / SOFT_RENDER_TILE_SIZE;
+  renderer->tilesY =
+      (height + SOFT_RENDER_TILE_SIZE - 1) / SOFT_RENDER_TILE_SIZE;
+  const int numTiles = renderer->tilesX * renderer->tilesY;
+
+  if (numThreads <= 0) {
+    numThreads = SDL_GetNumLogicalCPUCores();
+  }
+  numThreads = SDL_clamp(numThreads, 1, SOFT_RENDER_MAX_THREADS);
+
+  renderer->pixels = (Uint32 *)SDL_aligned_alloc(
+      16, sizeof(Uint32) * (size_t)renderer->pitch * (size_t)height);
+  renderer->tileStart =
+      (Uint32 *)SDL_calloc((size_t)numTiles + 1, sizeof(Uint32));
+  renderer->tileFill = (Uint32 *)SDL_calloc((size_t)numTiles, sizeof(Uint32));
+  renderer->workers = (SoftRenderWorker *)SDL_calloc(
+      (size_t)numThreads, sizeof(SoftRenderWorker));
+  renderer->lock = SDL_CreateMutex();
+  renderer->wake = SDL_CreateCondition();
+  renderer->done = SDL_CreateCondition();
+  if (renderer->pixels == NULL || renderer->tileStart == NULL ||
+      renderer->tileFill == NULL || renderer->workers == NULL ||
+      renderer->lock == NULL || renderer->wake == NULL ||
+      renderer->done == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't create software renderer: %s", SDL_GetError());
+    SoftRender_Destroy(renderer);
+    return false;
+  }
+
+  for (int i = 0; i < numThreads; i++) {
+    SoftRenderWorker *worker = &renderer->workers[i];
+    worker->renderer = renderer;
+    worker->tile = (Uint32 *)SDL_aligned_alloc(
+        16, sizeof(Uint32) * SOFT_RENDER_TILE_SIZE * SOFT_RENDER_TILE_SIZE);
+    if (worker->tile == NULL) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Couldn't allocate software render tile");
+      SoftRender_Destroy(renderer);
+      return false;
+    }
+    renderer->numWorkers++;
+    if (i == 0) {
+      continue;
+    }
+    worker->thread =
+        SDL_CreateThread(SoftRenderWorkerMain, "soft render", worker);
+    if (worker->thread == NULL) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Couldn't start software render thread: %s",
+                   SDL_GetError());
+      SoftRender_Destroy(renderer);
+      return false;
+    }
+  }
+  return true;
+}
+
+void SoftRender_Destroy(SoftRenderer *renderer) {
+  if (renderer == NULL) {
+    return;
+  }
+  if (renderer->lock != NULL) {
+    SDL_LockMutex(renderer->lock);
+    renderer->quit = true;
+    SDL_BroadcastCondition(renderer->wake);
+    SDL_UnlockMutex(renderer->lock);
+  }
+  for (int i = 0; i < renderer->numWorkers; i++) {
+    if (renderer->workers[i].thread != NULL) {
+      SDL_WaitThread(renderer->workers[i].thread, NULL);
+    }
+    SDL_aligned_free(renderer->workers[i].tile);
+  }
+  SDL_free(renderer->workers);
+  SDL_DestroyCondition(renderer->done);
+  SDL_DestroyCondition(renderer->wake);
+  SDL_DestroyMutex(renderer->lock);
+  SDL_free(renderer->binned);
+  SDL_free(renderer->pointX);
+  SDL_free(renderer->pointY);
+  SDL_free(renderer->tileFill);
+  SDL_free(renderer->tileStart);
+  SDL_aligned_free(renderer->pixels);
+  SDL_zerop(renderer);
+}
+
+bool SoftRender_Draw(SoftRenderer *renderer, const float *x, const float *y,
+                     const Uint32 *indices, Uint32 count) {
+  // Room for a whole trailing lane group.
+  const Uint32 padded =
+      (count + SOFT_RENDER_LANES - 1) / SOFT_RENDER_LANES * SOFT_RENDER_LANES;
+  if (padded > renderer->pointCapacity) {
+    int *pointX = (int *)SDL_realloc(renderer->pointX, sizeof(int) * padded);
+    if (pointX != NULL) {
+      renderer->pointX = pointX;
+    }
+    int *pointY = (int *)SDL_realloc(renderer->pointY, sizeof(int) * padded);
+    if (pointY != NULL) {
+      renderer->pointY = pointY;
+    }
+    if (pointX == NULL || pointY == NULL) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Couldn't allocate software render points");
+      return false;
+    }
+    renderer->pointCapacity = padded;
+  }
+
+  for (Uint32 i = 0; i < padded; i += SOFT_RENDER_LANES) {
+    // Gather one lane group; padding lanes land far off screen.
+    float laneX[SOFT_RENDER_LANES];
+    float laneY[SOFT_RENDER_LANES];
+    for (Uint32 lane = 0; lane < SOFT_RENDER_LANES; lane++) {
+      const Uint32 n = i + lane;
+      const Uint32 src = indices != NULL && n < count ? indices[n] : n;
+      laneX[lane] = n < count ? x[src] : -4.0f;
+      laneY[lane] = n < count ? y[src] : -4.0f;
+    }
+    TransformPoints(renderer, laneX, laneY, renderer->pointX + i,
+                    renderer->pointY + i);
+  }
+  if (!BinPoints(renderer, count)) {
+    return false;
+  }
+
+  SDL_SetAtomicInt(&renderer->nextTile, 0);
+  SDL_LockMutex(renderer->lock);
+  renderer->generation++;
+  renderer->busy = renderer->numWorkers - 1;
+  SDL_BroadcastCondition(renderer->wake);
+  SDL_UnlockMutex(renderer->lock);
+
+  RenderTiles(renderer, renderer->workers[0].tile);
+
+  SDL_LockMutex(renderer->lock);
+  while (renderer->busy > 0) {
+    SDL_WaitCondition(renderer->done, renderer->lock);
+  }
+  SDL_UnlockMutex(renderer->lock);
+  return true;
+}
+
+bool SoftRender_WritePPM(const SoftRenderer *renderer, const char *path) {
+  FILE *out = fopen(path, "wb");
+  if (out == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't open %s", path);
+    return false;
+  }
+  Uint8 *row = (Uint8 *)SDL_malloc(3 * (size_t)renderer->width);
+  bool ok = row != NULL &&
+            fprintf(out, "P6\n%d %d\n255\n", renderer->width,
+                    renderer->height) > 0;
+  for (int y = 0; ok && y < renderer->height; y++) {
+    const Uint8 *src =
+        (const Uint8 *)(renderer->pixels + (size_t)y * (size_t)renderer->pitch);
+    for (int x = 0; x < renderer->width; x++) {
+      row[3 * x + 0] = src[4 * x + 0];
+      row[3 * x + 1] = src[4 * x + 1];
+      row[3 * x + 2] = src[4 * x + 2];
+    }
+    ok = fwrite(row, 1, 3 * (size_t)renderer->width, out) ==
+         3 * (size_t)renderer->width;
+  }
+  ok = fclose(out) == 0 && ok;
+  SDL_free(row);
+  if (!ok) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't write %s", path);
+  }
+  return ok;
+}
@@ -0,0 +1,553 @@
+#include "sweep.h"
+
+#include <stdio.h>
+
+#include "sim.h"
+#include "soft_render.h"
+
+// Steps recorded per command buffer. Only one batch is in flight at a time so
+// the driver queue stays shallow on long sweeps.
+#define SWEEP_STEPS_PER_SUBMIT 32
+
+typedef struct SweepScene {
+  Uint32 particles;
+  // Pool slots the scene may grow into by splitting; 0 derives it from the
+  // mass floor (see SceneCapacity).
+  Uint32 capacity;
+  SceneParams params;
+  // Initial speed is uniform in [0, speed] per frame.
+  float speed;
+  Uint64 seed;
+} SweepScene;
+
+typedef struct SweepPlan {
+  Uint32 frames;
+  SweepScene *scenes;
+  Uint32 numScenes;
+} SweepPlan;
+
+static SweepScene DefaultScene(Uint32 index) {
+  return (SweepScene){.particles = 10000,
+                      .params = {.gravityX = 0.0f,
+                                 .gravityY = 0.0f,
+                                 .bounce = 0.98f,
+                                 .drag = 0.0f,
+                                 .smoothingRadius = 0.05f,
+                                 // 0 means the scene's starting particles per
+                                 // unit of domain area.
+                                 .restDensity = 0.0f,
+                                 // Ballistic unless asked for.
+                                 .stiffness = 0.0f,
+                                 // Fixed resolution unless max_mass is set.
+                                 .minMass = 0.25f,
+                                 .maxMass = 0.0f,
+                                 .surfaceRatio = 0.75f,
+                                 .calmSpeed = 0.002f,
+                                 // The NDC box unless domain= says otherwise.
+                                 .domainMinX = -1.0f,
+                                 .domainMinY = -1.0f,
+                                 .domainMaxX = 1.0f,
+                                 .domainMaxY = 1.0f},
+                      .speed = 0.01f,
+                      .seed = index + 1};
+}
+
+// Decimal count in 32 bits. sscanf's %u would wrap "-5" to 4294967291.
+static bool ParseCount(const char *text, Uint32 *out) {
+  if (*text < '0' || *text > '9') {
+    return false;
+  }
+  char *end = NULL;
+  const unsigned long value = SDL_strtoul(text, &end, 10);
+  if (*end != '\0' || value > SDL_MAX_UINT32) {
+    return false;
+  }
+  *out = (Uint32)value;
+  return true;
+}
+
+static bool ParseSceneKey(SweepScene *scene, const char *token, int lineNo) {
+  static const char *const kCountKeys[] = {"particles=", "capacity="};
+  Uint32 *const counts[] = {&scene->particles, &scene->capacity};
+  for (size_t i = 0; i < SDL_arraysize(kCountKeys); i++) {
+    const size_t length = SDL_strlen(kCountKeys[i]);
+    if (SDL_strncmp(token, kCountKeys[i], length) != 0) {
+      continue;
+    }
+    if (!ParseCount(token + length, counts[i])) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Sweep line %d: '%s' needs a count up to %u", lineNo,
+                   token, SDL_MAX_UINT32);
+      return false;
+    }
+    return true;
+  }
+
+  if (SDL_sscanf(token, "gravity=%f,%f", &scene->params.gravityX,
+                 &scene->params.gravityY) == 2 ||
+      SDL_sscanf(token, "bounce=%f", &scene->params.bounce) == 1 ||
+      SDL_sscanf(token, "drag=%f", &scene->params.drag) == 1 ||
+      SDL_sscanf(token, "smoothing=%f", &scene->params.smoothingRadius) == 1 ||
+      SDL_sscanf(token, "rest_density=%f", &scene->params.restDensity) == 1 ||
+      SDL_sscanf(token, "stiffness=%f", &scene->params.stiffness) == 1 ||
+      SDL_sscanf(token, "min_mass=%f", &scene->params.minMass) == 1 ||
+      SDL_sscanf(token, "max_mass=%f", &scene->params.maxMass) == 1 ||
+      SDL_sscanf(token, "surface_ratio=%f", &scene->params.surfaceRatio) == 1 ||
+      SDL_sscanf(token, "calm_speed=%f", &scene->params.calmSpeed) == 1 ||
+      SDL_sscanf(token, "domain=%f,%f,%f,%f", &scene->params.domainMinX,
+                 &scene->params.domainMinY, &scene->params.domainMaxX,
+                 &scene->params.domainMaxY) == 4 ||
+      SDL_sscanf(token, "speed=%f", &scene->speed) == 1) {
+    return true;
+  }
+  unsigned long long seed = 0;
+  if (SDL_sscanf(token, "seed=%llu", &seed) == 1) {
+    scene->seed = (Uint64)seed;
+    return true;
+  }
+  SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Sweep line %d: unknown key '%s'",
+               lineNo, token);
+  return false;
+}
+
+static bool ParsePlan(char *text, SweepPlan *plan) {
+  Uint32 sceneCapacity = 0;
+  plan->frames = 600;
+
+  char *lineState = NULL;
+  int lineNo = 0;
+  for (char *line = SDL_strtok_r(text, "\n", &lineState); line != NULL;
+       line = SDL_strtok_r(NULL, "\n", &lineState)) {
+    lineNo++;
+    char *comment = SDL_strchr(line, '#');
+    if (comment != NULL) {
+      *comment = '\0';
+    }
+
+    char *tokenState = NULL;
+    char *directive = SDL_strtok_r(line, " \t\r", &tokenState);
+    if (directive == NULL) {
+      continue;
+    }
+
+    if (SDL_strcmp(directive, "frames") == 0) {
+      char *value = SDL_strtok_r(NULL, " \t\r", &tokenState);
+      if (value == NULL || !ParseCount(value, &plan->frames)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Sweep line %d: frames needs a count", lineNo);
+        return false;
+      }
+    } else if (SDL_strcmp(directive, "scene") == 0) {
+      if (plan->numScenes == sceneCapacity) {
+        sceneCapacity = sceneCapacity > 0 ? sceneCapacity * 2 : 16;
+        SweepScene *grown = (SweepScene *)SDL_realloc(
+            plan->scenes, sizeof(SweepScene) * sceneCapacity);
+        if (grown == NULL) {
+          SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                       "Couldn't allocate sweep scenes");
+          return false;
+        }
+        plan->scenes = grown;
+      }
+      SweepScene *scene = &plan->scenes[plan->numScenes];
+      *scene = DefaultScene(plan->numScenes);
+      for (char *token = SDL_strtok_r(NULL, " \t\r", &tokenState);
+           token != NULL; token = SDL_strtok_r(NULL, " \t\r", &tokenState)) {
+        if (!ParseSceneKey(scene, token, lineNo)) {
+          return false;
+        }
+      }
+      plan->numScenes++;
+    } else {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Sweep line %d: unknown directive '%s'", lineNo, directive);
+      return false;
+    }
+  }
+
+  if (plan->numScenes == 0) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Sweep file has no scenes");
+    return false;
+  }
+  return true;
+}
+
+// Slots a scene can occupy. Splits conserve mass and stop at minMass, so
+// starting at unit mass an adaptive scene never holds more than
+// particles / minMass particles. The capacity key caps that bound.
+static bool SceneCapacity(const SweepScene *scene, Uint32 index,
+                          Uint64 *outCapacity) {
+  Uint64 bound = scene->particles;
+  const bool adaptive = scene->params.maxMass > 0.0f;
+  if (adaptive && scene->params.minMass > 0.0f) {
+    bound = (Uint64)SDL_ceil((double)scene->particles /
+                             SDL_min((double)scene->params.minMass, 1.0));
+  }
+  if (scene->capacity == 0) {
+    if (adaptive && scene->params.minMass <= 0.0f) {
+      SDL_Log("Sweep scene %u splits without a mass floor; it can't grow "
+              "without a capacity key",
+              index);
+    }
+    *outCapacity = bound;
+    return true;
+  }
+  if (scene->capacity < scene->particles) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Sweep scene %u: capacity %u is below its %u particles",
+                 index, scene->capacity, scene->particles);
+    return false;
+  }
+  *outCapacity = adaptive ? SDL_min(bound, (Uint64)scene->capacity)
+                          : scene->particles;
+  return true;
+}
+
+// Pool capacity for the whole batch. Scenes share the pool, so one scene's
+// headroom is free for any other's splits.
+static bool PlanCapacity(const SweepPlan *plan, Uint32 *outCapacity) {
+  Uint64 total = 0;
+  for (Uint32 s = 0; s < plan->numScenes; s++) {
+    Uint64 capacity = 0;
+    if (!SceneCapacity(&plan->scenes[s], s, &capacity)) {
+      return false;
+    }
+    total += capacity;
+  }
+  if (total > SDL_MAX_UINT32) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Sweep needs %llu particle slots; set capacity= on the "
+                 "adaptive scenes",
+                 (unsigned long long)total);
+    return false;
+  }
+  *outCapacity = (Uint32)total;
+  return true;
+}
+
+// Lays every scene out back to back in slot order.
+static bool BuildInitialState(const SweepPlan *plan,
+                              SimInitialState *initial) {
+  Uint32 total = 0;
+  for (Uint32 s = 0; s < plan->numScenes; s++) {
+    total += plan->scenes[s].particles;
+  }
+
+  float *xCurr = (float *)SDL_malloc(sizeof(float) * total);
+  float *yCurr = (float *)SDL_malloc(sizeof(float) * total);
+  float *xPrev = (float *)SDL_malloc(sizeof(float) * total);
+  float *yPrev = (float *)SDL_malloc(sizeof(float) * total);
+  float *mass = (float *)SDL_malloc(sizeof(float) * total);
+  Uint32 *sceneId = (Uint32 *)SDL_malloc(sizeof(Uint32) * total);
+  SceneParams *params =
+      (SceneParams *)SDL_malloc(sizeof(SceneParams) * plan->numScenes);
+  if (xCurr == NULL || yCurr == NULL || xPrev == NULL || yPrev == NULL ||
+      mass == NULL || sceneId == NULL || params == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't allocate sweep particle data");
+    SDL_free(xCurr);
+    SDL_free(yCurr);
+    SDL_free(xPrev);
+    SDL_free(yPrev);
+    SDL_free(mass);
+    SDL_free(sceneId);
+    SDL_free(params);
+    return false;
+  }
+
+  Uint32 slot = 0;
+  for (Uint32 s = 0; s < plan->numScenes; s++) {
+    const SweepScene *scene = &plan->scenes[s];
+    params[s] = scene->params;
+    const float minX = params[s].domainMinX;
+    const float minY = params[s].domainMinY;
+    const float width = params[s].domainMaxX - minX;
+    const float height = params[s].domainMaxY - minY;
+    if (params[s].restDensity <= 0.0f && width > 0.0f && height > 0.0f) {
+      params[s].restDensity = (float)scene->particles / (width * height);
+    }
+    // Per-scene stream so a scene's start state doesn't depend on its
+    // neighbours in the sweep file.
+    Uint64 rng = scene->seed;
+    for (Uint32 i = 0; i < scene->particles; i++, slot++) {
+      float posX = minX + SDL_randf_r(&rng) * width;
+      float posY = minY + SDL_randf_r(&rng) * height;
+      float angle = SDL_randf_r(&rng) * 6.28318530718f;
+      float speed = SDL_randf_r(&rng) * scene->speed;
+      xPrev[slot] = posX;
+      yPrev[slot] = posY;
+      xCurr[slot] = posX + SDL_cosf(angle) * speed;
+      yCurr[slot] = posY + SDL_sinf(angle) * speed;
+      mass[slot] = 1.0f;
+      sceneId[slot] = s;
+    }
+  }
+
+  *initial = (SimInitialState){.xCurr = xCurr,
+                               .yCurr = yCurr,
+                               .xPrev = xPrev,
+                               .yPrev = yPrev,
+                               .mass = mass,
+                               .sceneId = sceneId,
+                               .count = total,
+                               .scenes = params,
+                               .numScenes = plan->numScenes};
+  return true;
+}
+
+static void FreeInitialState(SimInitialState *initial) {
+  SDL_free((void *)initial->xCurr);
+  SDL_free((void *)initial->yCurr);
+  SDL_free((void *)initial->xPrev);
+  SDL_free((void *)initial->yPrev);
+  SDL_free((void *)initial->mass);
+  SDL_free((void *)initial->sceneId);
+  SDL_free((void *)initial->scenes);
+}
+
+static bool RunFrames(Sim *sim, SDL_GPUDevice *device, Uint32 frames) {
+  SDL_GPUFence *inFlight = NULL;
+  bool ok = true;
+  for (Uint32 done = 0; ok && done < frames;) {
+    SDL_GPUCommandBuffer *cmdBuf = SDL_AcquireGPUCommandBuffer(device);
+    if (cmdBuf == NULL) {
+      SDL_Log("SDL_AcquireGPUCommandBuffer failed: %s", SDL_GetError());
+      ok = false;
+      break;
+    }
+    Uint32 batch = SDL_min(frames - done, (Uint32)SWEEP_STEPS_PER_SUBMIT);
+    for (Uint32 i = 0; ok && i < batch; i++) {
+      ok = Sim_Step(sim, cmdBuf);
+    }
+    SDL_GPUFence *fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdBuf);
+    if (inFlight != NULL) {
+      SDL_WaitForGPUFences(device, true, &inFlight, 1);
+      SDL_ReleaseGPUFence(device, inFlight);
+    }
+    inFlight = fence;
+    done += batch;
+  }
+  if (inFlight != NULL) {
+    SDL_WaitForGPUFences(device, true, &inFlight, 1);
+    SDL_ReleaseGPUFence(device, inFlight);
+  }
+  return ok;
+}
+
+typedef struct SceneStats {
+  Uint32 alive;
+  double sumX;
+  double sumY;
+  double sumSpeed;
+  double kineticEnergy;
+} SceneStats;
+
+static bool WriteResults(const SweepPlan *plan, const SimSnapshot *snapshot,
+                         const char *outPath) {
+  SceneStats *stats =
+      (SceneStats *)SDL_calloc(plan->numScenes, sizeof(SceneStats));
+  if (stats == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't allocate sweep statistics");
+    return false;
+  }
+
+  for (Uint32 i = 0; i < snapshot->aliveCount; i++) {
+    Uint32 slot = snapshot->alive[i];
+    Uint32 scene = snapshot->sceneId[slot];
+    if (scene >= plan->numScenes) {
+      continue;
+    }
+    float velX = snapshot->xCurr[slot] - snapshot->xPrev[slot];
+    float velY = snapshot->yCurr[slot] - snapshot->yPrev[slot];
+    float speed2 = velX * velX + velY * velY;
+    SceneStats *s = &stats[scene];
+    s->alive++;
+    s->sumX += snapshot->xCurr[slot];
+    s->sumY += snapshot->yCurr[slot];
+    s->sumSpeed += SDL_sqrtf(speed2);
+    s->kineticEnergy += 0.5 * snapshot->mass[slot] * speed2;
+  }
+
+  FILE *out = outPath != NULL ? fopen(outPath, "w") : stdout;
+  if (out == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't open sweep output: %s", outPath);
+    SDL_free(stats);
+    return false;
+  }
+  fprintf(out, "scene,particles,alive,mean_x,mean_y,mean_speed,"
+               "kinetic_energy\n");
+  for (Uint32 s = 0; s < plan->numScenes; s++) {
+    const SceneStats *st = &stats[s];
+    double n = st->alive > 0 ? (double)st->alive : 1.0;
+    fprintf(out, "%u,%u,%u,%.6f,%.6f,%.8f,%.8e\n", s, plan->scenes[s].particles,
+            st->alive, st->sumX / n, st->sumY / n, st->sumSpeed / n,
+            st->kineticEnergy);
+  }
+  bool ok = !ferror(out);
+  if (out != stdout) {
+    ok = fclose(out) == 0 && ok;
+  } else {
+    fflush(out);
+  }
+
+  SDL_free(stats);
+  return ok;
+}
+
+// Draws every scene of a snapshot into its own frame.
+static bool RenderScenes(const SweepPlan *plan, const SimSnapshot *snapshot,
+                         SoftRenderer *renderer, const char *directory,
+                         Uint32 frame) {
+  // Group the live slots by scene so each frame draws one contiguous run.
+  Uint32 *sceneStart =
+      (Uint32 *)SDL_calloc((size_t)plan->numScenes + 1, sizeof(Uint32));
+  Uint32 *order =
+      (Uint32 *)SDL_malloc(sizeof(Uint32) * SDL_max(snapshot->aliveCount, 1));
+  if (sceneStart == NULL || order == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't allocate sweep render order");
+    SDL_free(sceneStart);
+    SDL_free(order);
+    return false;
+  }
+  for (Uint32 i = 0; i < snapshot->aliveCount; i++) {
+    Uint32 scene = snapshot->sceneId[snapshot->alive[i]];
+    if (scene < plan->numScenes) {
+      sceneStart[scene + 1]++;
+    }
+  }
+  for (Uint32 s = 0; s < plan->numScenes; s++) {
+    sceneStart[s + 1] += sceneStart[s];
+  }
+  Uint32 *fill = (Uint32 *)SDL_malloc(sizeof(Uint32) * plan->numScenes);
+  if (fill == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Couldn't allocate sweep render order");
+    SDL_free(sceneStart);
+    SDL_free(order);
+    return false;
+  }
+  SDL_memcpy(fill, sceneStart, sizeof(Uint32) * plan->numScenes);
+  for (Uint32 i = 0; i < snapshot->aliveCount; i++) {
+    Uint32 slot = snapshot->alive[i];
+    Uint32 scene = snapshot->sceneId[slot];
+    if (scene < plan->numScenes) {
+      order[fill[scene]++] = slot;
+    }
+  }
+  SDL_free(fill);
+
+  bool ok = true;
+  for (Uint32 s = 0; ok && s < plan->numScenes; s++) {
+    char path[1024];
+    SDL_snprintf(path, sizeof(path), "%s/scene%03u_frame%06u.ppm", directory,
+                 s, frame);
+    ok = SoftRender_Draw(renderer, snapshot->xCurr, snapshot->yCurr,
+                         order + sceneStart[s],
+                         sceneStart[s + 1] - sceneStart[s]) &&
+         SoftRender_WritePPM(renderer, path);
+  }
+  SDL_free(sceneStart);
+  SDL_free(order);
+  return ok;
+}
+
+static bool RenderCheckpoint(const Sim *sim, SDL_GPUDevice *device,
+                             const SweepPlan *plan, SoftRenderer *renderer,
+                             const char *directory, Uint32 frame) {
+  SimSnapshot snapshot;
+  Uint8 *data = Sim_DownloadSnapshot(sim, device, &snapshot);
+  bool ok = data != NULL &&
+            RenderScenes(plan, &snapshot, renderer, directory, frame);
+  SDL_free(data);
+  return ok;
+}
+
+bool Sweep_Run(SDL_GPUDevice *device, SDL_GPUShaderFormat shaderFormat,
+               const KernelConfig *kernels, const char *sweepPath,
+               const char *outPath, const SweepRenderSettings *render) {
+  size_t textSize = 0;
+  char *text = (char *)SDL_LoadFile(sweepPath, &textSize);
+  if (text == NULL) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't read sweep file %s: %s",
+                 sweepPath, SDL_GetError());
+    return false;
+  }
+
+  SweepPlan plan = {0};
+  bool ok = ParsePlan(text, &plan);
+  SDL_free(text);
+
+  Uint32 capacity = 0;
+  ok = ok && PlanCapacity(&plan, &capacity);
+  SimInitialState initial = {0};
+  ok = ok && BuildInitialState(&plan, &initial);
+
+  Sim sim;
+  bool simReady = false;
+  if (ok) {
+    // No emitters in a sweep; only splits need slots past the batch.
+    simReady =
+        Sim_Init(&sim, device, shaderFormat, capacity, &initial, kernels);
+    FreeInitialState(&initial);
+    ok = simReady;
+  }
+
+  const bool rendering = render != NULL && render->directory != NULL;
+  SoftRenderer renderer;
+  bool rendererReady = false;
+  if (ok && rendering) {
+    rendererReady = SoftRender_Init(&renderer, render->width, render->height,
+                                    render->threads);
+    ok = rendererReady;
+  }
+
+  if (ok) {
+    SDL_Log("Sweep: %u scenes, %u particles, %u slots, %u frames",
+            plan.numScenes, initial.count, sim.capacity, plan.frames);
+    Uint64 start = SDL_GetTicksNS();
+    // Stop at each render checkpoint; the final frame is drawn below from
+    // the same snapshot as the results.
+    for (Uint32 done = 0; ok && done < plan.frames;) {
+      Uint32 chunk = plan.frames - done;
+      if (rendering && render->every > 0) {
+        chunk = SDL_min(chunk, render->every);
+      }
+      ok = RunFrames(&sim, device, chunk);
+      done += chunk;
+      if (ok && rendering && done < plan.frames) {
+        ok = RenderCheckpoint(&sim, device, &plan, &renderer,
+                              render->directory, done);
+      }
+    }
+    SDL_Log("Sweep finished in %.3f s",
+            (double)(SDL_GetTicksNS() - start) / (double)SDL_NS_PER_SECOND);
+  }
+
+  if (ok) {
+    SimSnapshot snapshot;
+    Uint8 *data = Sim_DownloadSnapshot(&sim, device, &snapshot);
+    if (data != NULL && snapshot.listOverflow > 0) {
+      SDL_Log("Sweep: full neighbour lists dropped %u neighbours; forces "
+              "near them were one-sided",
+              snapshot.listOverflow);
+    }
+    ok = data != NULL && WriteResults(&plan, &snapshot, outPath);
+    if (ok && rendering) {
+      ok = RenderScenes(&plan, &snapshot, &renderer, render->directory,
+                        plan.frames);
+    }
+    SDL_free(data);
+  }
+
+  if (rendererReady) {
+    SoftRender_Destroy(&renderer);
+  }
+  if (simReady) {
+    Sim_Destroy(&sim, device);
+  }
+  SDL_free(plan.scenes);
+  return ok;
+}